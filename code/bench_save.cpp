@@ -0,0 +1,278 @@
+// Headless save game benchmark. Fills a PermanentStorage sized block the way a running game would, then
+// times what a save costs: the dirty page copy the main thread does at the frame boundary (the part that
+// hits the frame), and the LZ compress / decompress that happen on the save thread and at load. Runs once
+// for a full save and once for a typical delta, and prints sizes, ratio and times.
+//
+// The page copy is the same gather Win32BeginSave does. GetWriteWatch itself isn't in here, it needs the
+// real allocation. Build and run with test.bat (or `g++ -O2 bench_save.cpp` anywhere else).
+#include "handmade.h"
+#include "handmade_lz.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+#include <windows.h>
+internal real64 BenchGetMS()
+{
+	LARGE_INTEGER Counter;
+	LARGE_INTEGER Frequency;
+	QueryPerformanceCounter(&Counter);
+	QueryPerformanceFrequency(&Frequency);
+	return((1000.0*(real64)Counter.QuadPart) / (real64)Frequency.QuadPart);
+}
+#else
+#include <time.h>
+internal real64 BenchGetMS()
+{
+	timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return(1000.0*(real64)Time.tv_sec + (real64)Time.tv_nsec / 1000000.0);
+}
+#endif
+
+#define BENCH_MEMORY_SIZE Megabytes(64) // Same as the platform layer asks for
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_PAGE_COUNT (uint32)(BENCH_MEMORY_SIZE / BENCH_PAGE_SIZE)
+#define BENCH_ENTITY_COUNT 65536 // 4MB of entities
+#define BENCH_TILE_COUNT (1024*1024) // 2MB of tiles
+#define BENCH_ACTIVE_ENTITY_COUNT 4096 // Simulated each frame, the rest of the world sits still
+
+// Stand-in for the world a game would keep after game_state. Positions and velocities are the noisy
+// part, the rest is small ints and padding, like most game structs
+struct bench_entity
+{
+	real32 P[3];
+	real32 dP[3];
+	uint32 Flags;
+	uint16 Type;
+	uint16 HitPoints;
+	uint32 TargetIndex;
+	uint8 Reserved[28];
+};
+
+struct bench_world
+{
+	bench_entity Entities[BENCH_ENTITY_COUNT];
+	uint16 Tiles[BENCH_TILE_COUNT];
+};
+
+global_variable uint32 BenchRandomState = 0x12345678;
+internal uint32 BenchRandom()
+{
+	// xorshift32, deterministic so runs compare
+	BenchRandomState ^= BenchRandomState << 13;
+	BenchRandomState ^= BenchRandomState >> 17;
+	BenchRandomState ^= BenchRandomState << 5;
+	return(BenchRandomState);
+}
+
+internal real32 BenchRandomUnilateral()
+{
+	real32 Result = (real32)(BenchRandom() & 0xFFFFFF) / (real32)0xFFFFFF;
+	return(Result);
+}
+
+internal void SetPage(uint8 *Dirty, uint32 PageIndex)
+{
+	Dirty[PageIndex] = true;
+}
+
+internal void SetPages(uint8 *Dirty, void *Base, void *Start, uint64 Size)
+{
+	uint64 Offset = (uint8 *)Start - (uint8 *)Base;
+	for (uint64 PageIndex = Offset / BENCH_PAGE_SIZE; PageIndex <= (Offset + Size - 1) / BENCH_PAGE_SIZE; ++PageIndex)
+	{
+		SetPage(Dirty, (uint32)PageIndex);
+	}
+}
+
+// What the ring holds after a voice has been playing music for a while: a few tones and some noise
+internal void FillVoiceRings(audio_voice *Voice, real32 Time)
+{
+	for (int FrameIndex = 0; FrameIndex < AUDIO_VOICE_RING_FRAME_COUNT; ++FrameIndex)
+	{
+		real32 t = Time + (real32)FrameIndex / 44100.0f;
+		real32 Music = 4000.0f*sinf(2.0f*Pi32*220.0f*t) + 2500.0f*sinf(2.0f*Pi32*331.0f*t) + 1500.0f*sinf(2.0f*Pi32*1013.0f*t);
+		Voice->RingL[FrameIndex] = Music + 300.0f*BenchRandomUnilateral();
+		Voice->RingR[FrameIndex] = 0.8f*Music + 300.0f*BenchRandomUnilateral();
+	}
+	Voice->RingWriteFrame += AUDIO_VOICE_RING_FRAME_COUNT;
+	Voice->Position = (Voice->RingWriteFrame - 1000) << 32;
+}
+
+// Everything a game touches from the start, so all of it is in the full save
+internal void FillMemory(uint8 *Memory, uint8 *Dirty)
+{
+	game_state *GameState = (game_state *)Memory;
+	GameState->tSine = 1.234f;
+	audio_voice *Voice = &GameState->AudioState.Voices[0];
+	Voice->Playing = true;
+	strcpy(Voice->Stream.FileName, "../data/music.wav");
+	Voice->Stream.ChannelCount = 2;
+	Voice->Stream.SamplesPerSecond = 44100;
+	Voice->Stream.DataOffset = 44;
+	Voice->Stream.FrameCount = 44100*180;
+	Voice->Stream.Looping = true;
+	Voice->Volume = 1.0f;
+	Voice->Pitch = 1.0f;
+	FillVoiceRings(Voice, 0.0f);
+	SetPages(Dirty, Memory, GameState, sizeof(game_state));
+
+	bench_world *World = (bench_world *)(Memory + Kilobytes(256));
+	for (uint32 EntityIndex = 0; EntityIndex < BENCH_ENTITY_COUNT; ++EntityIndex)
+	{
+		bench_entity *Entity = &World->Entities[EntityIndex];
+		Entity->P[0] = (real32)(EntityIndex % 256)*4.0f + BenchRandomUnilateral();
+		Entity->P[1] = (real32)(EntityIndex / 256)*4.0f + BenchRandomUnilateral();
+		Entity->P[2] = 0.0f;
+		if ((BenchRandom() % 4) == 0)
+		{
+			Entity->dP[0] = BenchRandomUnilateral() - 0.5f;
+			Entity->dP[1] = BenchRandomUnilateral() - 0.5f;
+		}
+		Entity->Flags = 1 | ((BenchRandom() % 8) << 4);
+		Entity->Type = (uint16)(BenchRandom() % 12);
+		Entity->HitPoints = 100;
+		Entity->TargetIndex = (BenchRandom() % 16) ? 0 : (BenchRandom() % BENCH_ENTITY_COUNT);
+	}
+	for (uint32 TileIndex = 0; TileIndex < BENCH_TILE_COUNT; ++TileIndex)
+	{
+		// Mostly long runs of floor, with walls and props scattered through
+		World->Tiles[TileIndex] = ((BenchRandom() % 32) == 0) ? (uint16)(1 + (BenchRandom() % 64)) : 0;
+	}
+	SetPages(Dirty, Memory, World, sizeof(bench_world));
+}
+
+// About a second of play between saves: the audio ring has gone all the way round, the entities in the
+// simulated region around the player moved, and a few tiles changed
+internal void DirtyMemory(uint8 *Memory, uint8 *Dirty)
+{
+	game_state *GameState = (game_state *)Memory;
+	GameState->tSine += 0.5f;
+	FillVoiceRings(&GameState->AudioState.Voices[0], 1.0f);
+	SetPages(Dirty, Memory, GameState, sizeof(game_state));
+
+	bench_world *World = (bench_world *)(Memory + Kilobytes(256));
+	uint32 FirstActive = BenchRandom() % (BENCH_ENTITY_COUNT - BENCH_ACTIVE_ENTITY_COUNT);
+	for (uint32 EntityIndex = FirstActive; EntityIndex < (FirstActive + BENCH_ACTIVE_ENTITY_COUNT); ++EntityIndex)
+	{
+		bench_entity *Entity = &World->Entities[EntityIndex];
+		Entity->P[0] += Entity->dP[0];
+		Entity->P[1] += Entity->dP[1];
+		Entity->HitPoints -= (BenchRandom() % 8) ? 0 : 1;
+		SetPages(Dirty, Memory, Entity, sizeof(*Entity));
+	}
+	for (uint32 TileChange = 0; TileChange < 32; ++TileChange)
+	{
+		uint16 *Tile = &World->Tiles[BenchRandom() % BENCH_TILE_COUNT];
+		*Tile = (uint16)(BenchRandom() % 64);
+		SetPages(Dirty, Memory, Tile, sizeof(*Tile));
+	}
+}
+
+// The Win32BeginSave gather: indices first, then the contents of each page in the same order.
+// Returns the uncompressed size
+internal uint32 CopyDirtyPages(uint8 *Memory, uint8 *Dirty, uint8 *Staging, uint32 *PageCount)
+{
+	*PageCount = 0;
+	for (uint32 PageIndex = 0; PageIndex < BENCH_PAGE_COUNT; ++PageIndex)
+	{
+		if (Dirty[PageIndex])
+		{
+			++*PageCount;
+		}
+	}
+
+	uint32 *PageIndices = (uint32 *)Staging;
+	uint8 *PageContents = Staging + *PageCount*sizeof(uint32);
+	for (uint32 PageIndex = 0; PageIndex < BENCH_PAGE_COUNT; ++PageIndex)
+	{
+		if (Dirty[PageIndex])
+		{
+			*PageIndices++ = PageIndex;
+			memcpy(PageContents, Memory + PageIndex*BENCH_PAGE_SIZE, BENCH_PAGE_SIZE);
+			PageContents += BENCH_PAGE_SIZE;
+		}
+	}
+
+	return((uint32)(PageContents - Staging));
+}
+
+struct bench_buffers
+{
+	uint8 *Staging;
+	uint8 *Compressed;
+	uint8 *Decompressed;
+	uint32 *HashTable;
+};
+
+// Best of RunCount, so a busy machine only ever makes the numbers look worse
+internal bool32 RunSaveBench(char *Name, uint8 *Memory, uint8 *Dirty, bench_buffers *Buffers, int RunCount)
+{
+	real64 CopyMS = 1e30;
+	real64 CompressMS = 1e30;
+	real64 DecompressMS = 1e30;
+	uint32 PageCount = 0;
+	uint32 UncompressedSize = 0;
+	uint32 CompressedSize = 0;
+	bool32 RoundTrips = true;
+
+	for (int RunIndex = 0; RunIndex < RunCount; ++RunIndex)
+	{
+		real64 Start = BenchGetMS();
+		UncompressedSize = CopyDirtyPages(Memory, Dirty, Buffers->Staging, &PageCount);
+		real64 Copied = BenchGetMS();
+		CompressedSize = LZCompress(Buffers->Staging, UncompressedSize, Buffers->Compressed, Buffers->HashTable);
+		real64 Compressed = BenchGetMS();
+		uint32 DecompressedSize = LZDecompress(Buffers->Compressed, CompressedSize, Buffers->Decompressed, UncompressedSize);
+		real64 Decompressed = BenchGetMS();
+
+		if ((DecompressedSize != UncompressedSize) || memcmp(Buffers->Decompressed, Buffers->Staging, UncompressedSize))
+		{
+			RoundTrips = false;
+		}
+
+		if ((Copied - Start) < CopyMS) CopyMS = Copied - Start;
+		if ((Compressed - Copied) < CompressMS) CompressMS = Compressed - Copied;
+		if ((Decompressed - Compressed) < DecompressMS) DecompressMS = Decompressed - Compressed;
+	}
+
+	printf("%s: %u pages, %ukb to %ukb (%.1f%%)\n", Name, PageCount, UncompressedSize / 1024, CompressedSize / 1024,
+		100.0*(real64)CompressedSize / (real64)UncompressedSize);
+	printf("%s: page copy %.3fms (main thread), compress %.2fms (%.0fMB/s), decompress %.2fms (%.0fMB/s)\n", Name,
+		CopyMS, CompressMS, ((real64)UncompressedSize / (1024.0*1024.0)) / (CompressMS / 1000.0),
+		DecompressMS, ((real64)UncompressedSize / (1024.0*1024.0)) / (DecompressMS / 1000.0));
+	if (!RoundTrips)
+	{
+		printf("%s: decompressed pages don't match\n", Name);
+	}
+
+	return(RoundTrips);
+}
+
+int main(int ArgCount, char **Args)
+{
+	uint8 *Memory = (uint8 *)calloc(1, BENCH_MEMORY_SIZE);
+	uint8 *Dirty = (uint8 *)calloc(BENCH_PAGE_COUNT, 1);
+
+	// Worst case sizes, the same as Win32InitSaveState reserves
+	uint32 StagingSize = BENCH_PAGE_COUNT*(sizeof(uint32) + BENCH_PAGE_SIZE);
+	bench_buffers Buffers = {};
+	Buffers.Staging = (uint8 *)malloc(StagingSize);
+	Buffers.Compressed = (uint8 *)malloc(LZCompressBound(StagingSize));
+	Buffers.Decompressed = (uint8 *)malloc(StagingSize);
+	Buffers.HashTable = (uint32 *)malloc(LZ_HASH_COUNT*sizeof(uint32));
+
+	bool32 Passed = true;
+
+	FillMemory(Memory, Dirty);
+	Passed &= RunSaveBench("full", Memory, Dirty, &Buffers, 10);
+
+	memset(Dirty, 0, BENCH_PAGE_COUNT);
+	DirtyMemory(Memory, Dirty);
+	Passed &= RunSaveBench("delta", Memory, Dirty, &Buffers, 100);
+
+	return(Passed ? 0 : 1);
+}
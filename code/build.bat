@@ -12,7 +12,8 @@ pushd ..\build
 ::   `-Zi` builds with .pdp debug files
 ::   `-FC` specifies full path name
 ::   `-O2` does optimization
-cl -FC -Zi ..\code\win32_handmade.cpp user32.lib gdi32.lib
+::   `-DHANDMADE_INTERNAL=1` builds in debug-only code (the frame time overlay)
+cl -DHANDMADE_INTERNAL=1 -FC -Zi ..\code\win32_handmade.cpp user32.lib gdi32.lib
 
 :: Pop directory back to starting directory
 popd
\ No newline at end of file
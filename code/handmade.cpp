@@ -1,8 +1,17 @@
 #include "handmade.h"
 
-internal void GameOutputSound(game_sound_output_buffer *SoundBuffer, int ToneHz)
+#if HANDMADE_INTERNAL
+#include <stdio.h>
+
+// Only valid during GameUpdateAndRender, so the timed block macros don't need a parameter
+global_variable game_debug_state *DebugGlobalState;
+#endif
+
+#include "handmade_audio.cpp"
+
+// Test tone, for when there's no music to stream
+internal void GameOutputSineWave(game_state *GameState, game_sound_output_buffer *SoundBuffer, int ToneHz)
 {
-	local_persist real32 tSine; // Output it directly from here
 	int16 ToneVolume = 3000;
 	int WavePeriod = SoundBuffer->SamplesPerSecond / ToneHz; // How many samples do we need to fill to get 256Hz
 
@@ -11,37 +20,417 @@ internal void GameOutputSound(game_sound_output_buffer *SoundBuffer, int ToneHz)
 		SampleIndex < SoundBuffer->SampleCount;
 		++SampleIndex)
 	{
-		real32 SineValue = sinf(tSine);
+		real32 SineValue = sinf(GameState->tSine);
 		int16 SampleValue = (int16)(SineValue * ToneVolume);
 		*SampleOut++ = SampleValue;
 		*SampleOut++ = SampleValue;
 
-		tSine += 2.0f*Pi32*1.0f/(real32)WavePeriod; // Period of sine is 2pi 
+		GameState->tSine += 2.0f*Pi32*1.0f/(real32)WavePeriod; // Period of sine is 2pi
 	}
 }
 
-internal void RenderWeirdGradient(game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset)
+internal void GameOutputSound(game_state *GameState, game_sound_output_buffer *SoundBuffer, int ToneHz)
+{
+	BEGIN_TIMED_BLOCK(GameOutputSound);
+
+	bool32 AnyVoicePlaying = false;
+	for (int VoiceIndex = 0; VoiceIndex < AUDIO_MAX_VOICES; ++VoiceIndex)
+	{
+		AnyVoicePlaying |= GameState->AudioState.Voices[VoiceIndex].Playing;
+	}
+
+	if (AnyVoicePlaying)
+	{
+		AudioMixVoices(&GameState->AudioState, SoundBuffer);
+	}
+	else
+	{
+		GameOutputSineWave(GameState, SoundBuffer, ToneHz);
+	}
+
+	END_TIMED_BLOCK(GameOutputSound);
+}
+
+// Channels are 0 to 255. Shared by every kernel that builds a pixel in one of the integer formats
+#define PACK_BGRA8(Red, Green, Blue) ((0xFFu << 24) | ((Red) << 16) | ((Green) << 8) | (Blue)) // Little endian (255,0,0,0 will draw blue)
+#define PACK_RGBA8(Red, Green, Blue) ((0xFFu << 24) | ((Blue) << 16) | ((Green) << 8) | (Red))
+#define PACK_RGB565(Red, Green, Blue) ((((Red) >> 3) << 11) | (((Green) >> 2) << 5) | ((Blue) >> 3))
+
+// One kernel per format, stamped out by the preprocessor rather than templates, so the inner loop is a
+// plain store even in debug builds where nothing gets inlined
+#define RENDER_WEIRD_GRADIENT_KERNEL(Name, PixelType, Pack) \
+internal void Name(game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset) \
+{ \
+	uint8 *Row = (uint8 *)Buffer->Memory; \
+	for (int Y = 0; Y < Buffer->Height; ++Y) \
+	{ \
+		PixelType *Pixel = (PixelType *)Row; \
+		for (int X = 0; X < Buffer->Width; ++X) \
+		{ \
+			uint8 Blue = (X + BlueOffset); \
+			uint8 Green = (Y + GreenOffset); \
+			*Pixel++ = (PixelType)Pack(0, Green, Blue); \
+		} \
+		Row += Buffer->Pitch; \
+	} \
+}
+
+RENDER_WEIRD_GRADIENT_KERNEL(RenderWeirdGradientBGRA8, uint32, PACK_BGRA8)
+RENDER_WEIRD_GRADIENT_KERNEL(RenderWeirdGradientRGBA8, uint32, PACK_RGBA8)
+RENDER_WEIRD_GRADIENT_KERNEL(RenderWeirdGradientRGB565, uint16, PACK_RGB565)
+
+internal void RenderWeirdGradientRGBA32F(game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset)
 {
-	// Cast void pointer to unsigned char (typedef uint8)
 	uint8 *Row = (uint8 *)Buffer->Memory;
 	for (int Y = 0; Y < Buffer->Height; ++Y)
 	{
-		uint32 *Pixel = (uint32 *)Row;
+		real32 *Pixel = (real32 *)Row;
 		for (int X = 0; X < Buffer->Width; ++X)
 		{
-			// Little endian (255,0,0,0 will draw blue)
 			uint8 Blue = (X + BlueOffset);
 			uint8 Green = (Y + GreenOffset);
+			Pixel[0] = 0.0f;
+			Pixel[1] = (real32)Green*(1.0f / 255.0f);
+			Pixel[2] = (real32)Blue*(1.0f / 255.0f);
+			Pixel[3] = 1.0f;
+			Pixel += 4;
+		}
+		Row += Buffer->Pitch;
+	}
+}
+
+internal void RenderWeirdGradient(game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset)
+{
+	BEGIN_TIMED_BLOCK(RenderWeirdGradient);
+
+	// Pick the kernel once per frame, never per pixel
+	switch (Buffer->Format)
+	{
+	case PixelFormat_BGRA8: RenderWeirdGradientBGRA8(Buffer, BlueOffset, GreenOffset); break;
+	case PixelFormat_RGBA8: RenderWeirdGradientRGBA8(Buffer, BlueOffset, GreenOffset); break;
+	case PixelFormat_RGB565: RenderWeirdGradientRGB565(Buffer, BlueOffset, GreenOffset); break;
+	case PixelFormat_RGBA32F: RenderWeirdGradientRGBA32F(Buffer, BlueOffset, GreenOffset); break;
+	}
 
-			*Pixel++ = ((Green << 8) | Blue);
+	END_TIMED_BLOCK(RenderWeirdGradient);
+}
+
+#if HANDMADE_INTERNAL
+// Max bounds are exclusive, and everything is clipped to the buffer. Color is already packed for the
+// buffer format (DebugPackColor), so the integer kernels only store it
+#define DEBUG_FILL_RECTANGLE(name) void name(game_offscreen_buffer *Buffer, int MinX, int MinY, int MaxX, int MaxY, uint32 Color)
+typedef DEBUG_FILL_RECTANGLE(debug_fill_rectangle);
+
+#define DEBUG_FILL_RECTANGLE_KERNEL(Name, PixelType) \
+internal DEBUG_FILL_RECTANGLE(Name) \
+{ \
+	if (MinX < 0) MinX = 0; \
+	if (MinY < 0) MinY = 0; \
+	if (MaxX > Buffer->Width) MaxX = Buffer->Width; \
+	if (MaxY > Buffer->Height) MaxY = Buffer->Height; \
+ \
+	uint8 *Row = (uint8 *)Buffer->Memory + MinY*Buffer->Pitch + MinX*sizeof(PixelType); \
+	for (int Y = MinY; Y < MaxY; ++Y) \
+	{ \
+		PixelType *Pixel = (PixelType *)Row; \
+		for (int X = MinX; X < MaxX; ++X) \
+		{ \
+			*Pixel++ = (PixelType)Color; \
+		} \
+		Row += Buffer->Pitch; \
+	} \
+}
+
+DEBUG_FILL_RECTANGLE_KERNEL(DebugFillRectangle32, uint32)
+DEBUG_FILL_RECTANGLE_KERNEL(DebugFillRectangle16, uint16)
+
+// Color stays 0xRRGGBB for this one, and gets unpacked once per rectangle
+internal DEBUG_FILL_RECTANGLE(DebugFillRectangleRGBA32F)
+{
+	if (MinX < 0) MinX = 0;
+	if (MinY < 0) MinY = 0;
+	if (MaxX > Buffer->Width) MaxX = Buffer->Width;
+	if (MaxY > Buffer->Height) MaxY = Buffer->Height;
+
+	real32 Red = (real32)((Color >> 16) & 0xFF)*(1.0f / 255.0f);
+	real32 Green = (real32)((Color >> 8) & 0xFF)*(1.0f / 255.0f);
+	real32 Blue = (real32)((Color >> 0) & 0xFF)*(1.0f / 255.0f);
+
+	uint8 *Row = (uint8 *)Buffer->Memory + MinY*Buffer->Pitch + MinX*4*sizeof(real32);
+	for (int Y = MinY; Y < MaxY; ++Y)
+	{
+		real32 *Pixel = (real32 *)Row;
+		for (int X = MinX; X < MaxX; ++X)
+		{
+			Pixel[0] = Red;
+			Pixel[1] = Green;
+			Pixel[2] = Blue;
+			Pixel[3] = 1.0f;
+			Pixel += 4;
 		}
 		Row += Buffer->Pitch;
 	}
 }
 
+// Takes 0xRRGGBB
+internal uint32 DebugPackColor(game_pixel_format Format, uint32 Color)
+{
+	uint32 Red = (Color >> 16) & 0xFF;
+	uint32 Green = (Color >> 8) & 0xFF;
+	uint32 Blue = (Color >> 0) & 0xFF;
+
+	uint32 Result = Color;
+	switch (Format)
+	{
+	case PixelFormat_BGRA8: Result = PACK_BGRA8(Red, Green, Blue); break;
+	case PixelFormat_RGBA8: Result = PACK_RGBA8(Red, Green, Blue); break;
+	case PixelFormat_RGB565: Result = PACK_RGB565(Red, Green, Blue); break;
+	case PixelFormat_RGBA32F: break;
+	}
+	return(Result);
+}
+
+// The overlay's buffer with the fill kernel for its format, picked once per draw
+struct debug_draw_target
+{
+	game_offscreen_buffer *Buffer;
+	debug_fill_rectangle *FillRectangle;
+};
+
+// 3x5 debug font. One octal digit per row, top row first, bit 2 is the leftmost column
+internal uint16 DebugGetGlyph(char C)
+{
+	local_persist uint16 Digits[10] = {
+		075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717,
+	};
+	local_persist uint16 Letters[26] = {
+		025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152, 055655, 044447, 057755,
+		065555, 025552, 065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, 055255, 055222, 071247,
+	};
+
+	uint16 Result = 0;
+	if ((C >= '0') && (C <= '9'))
+	{
+		Result = Digits[C - '0'];
+	}
+	else if ((C >= 'A') && (C <= 'Z'))
+	{
+		Result = Letters[C - 'A'];
+	}
+	else if ((C >= 'a') && (C <= 'z'))
+	{
+		Result = Letters[C - 'a'];
+	}
+	else
+	{
+		switch (C)
+		{
+		case '.': Result = 000002; break;
+		case ':': Result = 002020; break;
+		case '/': Result = 011244; break;
+		case '-': Result = 000700; break;
+		}
+	}
+	return(Result);
+}
+
+#define DEBUG_FONT_SCALE 2
+#define DEBUG_FONT_ADVANCE (4*DEBUG_FONT_SCALE)
+#define DEBUG_LINE_HEIGHT (7*DEBUG_FONT_SCALE)
+
+// Returns the X just past the last glyph, so differently coloured runs can be chained
+internal int DebugDrawText(debug_draw_target *Target, int X, int Y, char *Text, uint32 Color)
+{
+	for (char *At = Text; *At; ++At)
+	{
+		uint16 Glyph = DebugGetGlyph(*At);
+		for (int GlyphY = 0; GlyphY < 5; ++GlyphY)
+		{
+			uint16 Bits = (Glyph >> (3*(4 - GlyphY))) & 07;
+			for (int GlyphX = 0; GlyphX < 3; ++GlyphX)
+			{
+				if (Bits & (4 >> GlyphX))
+				{
+					int MinX = X + GlyphX*DEBUG_FONT_SCALE;
+					int MinY = Y + GlyphY*DEBUG_FONT_SCALE;
+					Target->FillRectangle(Target->Buffer, MinX, MinY, MinX + DEBUG_FONT_SCALE, MinY + DEBUG_FONT_SCALE, Color);
+				}
+			}
+		}
+		X += DEBUG_FONT_ADVANCE;
+	}
+	return(X);
+}
+
+internal void DebugDrawSoundCursor(debug_draw_target *Target, game_debug_state *DebugState,
+									int X, int Y, int Width, int Height, uint32 Cursor, uint32 Color)
+{
+	if (DebugState->SoundBufferSize)
+	{
+		int CursorX = X + (int)(((uint64)Cursor*(uint64)Width) / DebugState->SoundBufferSize);
+		Target->FillRectangle(Target->Buffer, CursorX, Y - 2, CursorX + 2, Y + Height + 2, Color);
+	}
+}
+
+// Draws last frame's numbers (this frame's are still being accumulated)
+internal void DebugDrawOverlay(game_offscreen_buffer *Buffer, game_debug_state *DebugState)
+{
+	BEGIN_TIMED_BLOCK(DebugDrawOverlay);
+
+	debug_draw_target Target = {};
+	Target.Buffer = Buffer;
+	switch (Buffer->Format)
+	{
+	case PixelFormat_BGRA8: Target.FillRectangle = DebugFillRectangle32; break;
+	case PixelFormat_RGBA8: Target.FillRectangle = DebugFillRectangle32; break;
+	case PixelFormat_RGB565: Target.FillRectangle = DebugFillRectangle16; break;
+	case PixelFormat_RGBA32F: Target.FillRectangle = DebugFillRectangleRGBA32F; break;
+	}
+
+	// Packed for the buffer format once up front, not per rectangle
+	uint32 White = DebugPackColor(Buffer->Format, 0xFFFFFF);
+	uint32 Red = DebugPackColor(Buffer->Format, 0xFF4040);
+	uint32 Green = DebugPackColor(Buffer->Format, 0x40FF40);
+	uint32 Yellow = DebugPackColor(Buffer->Format, 0xFFFF40);
+	uint32 Grey = DebugPackColor(Buffer->Format, 0x404040);
+	uint32 Panel = DebugPackColor(Buffer->Format, 0x101010);
+
+	int BarWidth = 2;
+	int GraphWidth = DEBUG_FRAME_HISTORY_COUNT*BarWidth;
+	int GraphHeight = 64;
+	int Margin = 8;
+
+	int PanelX = 8;
+	int PanelY = 8;
+	int PanelWidth = GraphWidth + 2*Margin;
+	int PanelHeight = 2*Margin + (4 + DebugCycleCounter_Count)*DEBUG_LINE_HEIGHT + GraphHeight + 30;
+	Target.FillRectangle(Buffer, PanelX, PanelY, PanelX + PanelWidth, PanelY + PanelHeight, Panel);
+
+	int X = PanelX + Margin;
+	int Y = PanelY + Margin;
+	char Text[64];
+
+	int LastFrameIndex = (DebugState->FrameIndex + DEBUG_FRAME_HISTORY_COUNT - 1) % DEBUG_FRAME_HISTORY_COUNT;
+	snprintf(Text, sizeof(Text), "%.2fms/f %.1ffps %.1fmc/f",
+		DebugState->FrameMS[LastFrameIndex], DebugState->FPS, DebugState->MCPF);
+	DebugDrawText(&Target, X, Y, Text, White);
+	Y += DEBUG_LINE_HEIGHT;
+
+	// Frame time graph, oldest on the left. The target sits at half height so misses have room to show
+	real32 PixelsPerMS = 0.0f;
+	if (DebugState->TargetMSPerFrame > 0.0f)
+	{
+		PixelsPerMS = (0.5f*(real32)GraphHeight) / DebugState->TargetMSPerFrame;
+	}
+	int GraphBottom = Y + GraphHeight;
+	for (int BarIndex = 0; BarIndex < DEBUG_FRAME_HISTORY_COUNT; ++BarIndex)
+	{
+		real32 FrameMS = DebugState->FrameMS[(DebugState->FrameIndex + BarIndex) % DEBUG_FRAME_HISTORY_COUNT];
+		int BarHeight = (int)(FrameMS*PixelsPerMS);
+		if (BarHeight > GraphHeight) BarHeight = GraphHeight;
+
+		int BarX = X + BarIndex*BarWidth;
+		uint32 Color = (FrameMS <= DebugState->TargetMSPerFrame) ? Green : Red;
+		Target.FillRectangle(Buffer, BarX, GraphBottom - BarHeight, BarX + BarWidth, GraphBottom, Color);
+	}
+	int TargetY = GraphBottom - GraphHeight/2;
+	Target.FillRectangle(Buffer, X, TargetY, X + GraphWidth, TargetY + 1, White);
+	Y = GraphBottom + 4;
+
+	// Per-block cycle breakdown
+	char *CounterNames[DebugCycleCounter_Count] = {
+		"update", "sound", "mix", "gradient", "overlay",
+	};
+	for (int CounterIndex = 0; CounterIndex < DebugCycleCounter_Count; ++CounterIndex)
+	{
+		debug_cycle_counter *Counter = &DebugState->LastCounters[CounterIndex];
+		real32 MS = 0.0f;
+		if (DebugState->CyclesPerMS > 0.0f)
+		{
+			MS = (real32)Counter->CycleCount / DebugState->CyclesPerMS;
+		}
+
+		uint32 Color = White;
+		if ((CounterIndex == DebugCycleCounter_DebugDrawOverlay) && (MS > DEBUG_OVERLAY_BUDGET_MS))
+		{
+			Color = Red;
+		}
+
+		snprintf(Text, sizeof(Text), "%-8s %7.3fmc %6.3fms %ux", CounterNames[CounterIndex],
+			(real32)Counter->CycleCount / (1000.0f*1000.0f), MS, Counter->HitCount);
+		DebugDrawText(&Target, X, Y, Text, Color);
+		Y += DEBUG_LINE_HEIGHT;
+	}
+
+	// Sound buffer with cursors, legend colours match the markers
+	int SoundX = X;
+	SoundX = DebugDrawText(&Target, SoundX, Y, "play ", White);
+	SoundX = DebugDrawText(&Target, SoundX, Y, "write ", Red);
+	SoundX = DebugDrawText(&Target, SoundX, Y, "lock ", Yellow);
+	SoundX = DebugDrawText(&Target, SoundX, Y, "target", Green);
+	Y += DEBUG_LINE_HEIGHT + 2;
+
+	int SoundHeight = 8;
+	debug_sound_cursors *Cursors = &DebugState->SoundCursors;
+	Target.FillRectangle(Buffer, X, Y, X + GraphWidth, Y + SoundHeight, Grey);
+	DebugDrawSoundCursor(&Target, DebugState, X, Y, GraphWidth, SoundHeight, Cursors->PlayCursor, White);
+	DebugDrawSoundCursor(&Target, DebugState, X, Y, GraphWidth, SoundHeight, Cursors->WriteCursor, Red);
+	DebugDrawSoundCursor(&Target, DebugState, X, Y, GraphWidth, SoundHeight, Cursors->ByteToLock, Yellow);
+	DebugDrawSoundCursor(&Target, DebugState, X, Y, GraphWidth, SoundHeight, Cursors->TargetCursor, Green);
+	Y += SoundHeight + 6;
+
+	// Last save game. Snapshot time is what the frame paid, the rest happened on the save thread
+	debug_save_stats *SaveStats = &DebugState->SaveStats;
+	snprintf(Text, sizeof(Text), "save %u pages %ukb to %ukb", SaveStats->PageCount,
+		SaveStats->UncompressedSize / 1024, SaveStats->CompressedSize / 1024);
+	DebugDrawText(&Target, X, Y, Text, White);
+	Y += DEBUG_LINE_HEIGHT;
+	snprintf(Text, sizeof(Text), "snapshot %.3fms worker %.2fms", SaveStats->SnapshotMS, SaveStats->WorkerMS);
+	DebugDrawText(&Target, X, Y, Text, White);
+
+	END_TIMED_BLOCK(DebugDrawOverlay);
+}
+#endif
+
+internal void GamePrepareForLoad(game_memory *Memory)
+{
+	game_state *GameState = (game_state *)Memory->PermanentStorage;
+	if (Memory->IsInitialized)
+	{
+		CloseVoiceFiles(&GameState->AudioState);
+	}
+}
+
 // Platform-independent update loop
-internal void GameUpdateAndRender(game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset, game_sound_output_buffer *SoundBuffer, int ToneHz)
+internal void GameUpdateAndRender(game_memory *Memory, game_offscreen_buffer *Buffer, int BlueOffset, int GreenOffset, game_sound_output_buffer *SoundBuffer, int ToneHz,
+									game_debug_state *DebugState)
 {
-	GameOutputSound(SoundBuffer, ToneHz); // How many samples of sound to output
+#if HANDMADE_INTERNAL
+	DebugGlobalState = DebugState;
+#endif
+	BEGIN_TIMED_BLOCK(GameUpdateAndRender);
+
+	game_state *GameState = (game_state *)Memory->PermanentStorage;
+	// Restore first: a save can be loaded before the first frame, and its voices must not get a fresh start on top
+	if (Memory->WasRestored)
+	{
+		ReopenVoices(&GameState->AudioState);
+		Memory->WasRestored = false;
+		Memory->IsInitialized = true;
+	}
+	if (!Memory->IsInitialized)
+	{
+		// Falls back to the test tone if the file isn't there
+		PlayWav(&GameState->AudioState, "../data/music.wav", true, 1.0f);
+		Memory->IsInitialized = true;
+	}
+
+	GameOutputSound(GameState, SoundBuffer, ToneHz); // How many samples of sound to output
 	RenderWeirdGradient(Buffer, BlueOffset, GreenOffset);
-}
\ No newline at end of file
+
+#if HANDMADE_INTERNAL
+	DebugDrawOverlay(Buffer, DebugState);
+#endif
+
+	END_TIMED_BLOCK(GameUpdateAndRender);
+}
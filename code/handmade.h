@@ -3,12 +3,22 @@
 #include <math.h>
 #include <stdint.h>
 
+// RDTSC intrinsic for the debug cycle counters
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
 #define local_persist static // Can't be used outside this translation unit (source file)
 #define global_variable static 
 #define internal static
 
 #define Pi32 3.14159265359f
 
+#define Kilobytes(Value) ((Value)*1024LL)
+#define Megabytes(Value) (Kilobytes(Value)*1024LL)
+
 typedef int8_t int8;
 typedef int16_t int16;
 typedef int32_t int32;
@@ -23,10 +33,55 @@ typedef uint64_t uint64;
 typedef float real32;
 typedef double real64;
 
-// TODO(max): Services that the platform layer provides to the game
+// NOTE(max): Services that the platform layer provides to the game
+struct platform_file_handle
+{
+	bool32 NoErrors;
+	uint64 Size;
+	void *Platform; // HANDLE on Win32
+};
+
+internal platform_file_handle PlatformOpenFile(char *FileName);
+// Reads at an absolute byte offset, so there's no file pointer to keep in sync. Returns the bytes actually read
+internal uint32 PlatformReadFromFile(platform_file_handle *Handle, uint64 Offset, uint32 Size, void *Dest);
+internal void PlatformCloseFile(platform_file_handle *Handle);
+
+struct platform_read_file_result
+{
+	uint32 ContentsSize;
+	void *Contents;
+};
+
+// Whole-file helpers, for things small enough to just pull into memory (save games)
+internal platform_read_file_result PlatformReadEntireFile(char *FileName);
+internal void PlatformFreeFileMemory(void *Memory);
+// Atomic: the old file is either left alone or completely replaced, never half written
+internal bool32 PlatformWriteEntireFile(char *FileName, uint32 MemorySize, void *Memory);
 
 // NOTE(max): Services that the game provides to the playform layer
 
+// Memory layout of a pixel, lowest address first. The platform picks whatever it can present without
+// converting, and the renderer has a kernel for each
+enum game_pixel_format
+{
+	PixelFormat_BGRA8, // Win32 DIB sections
+	PixelFormat_RGBA8,
+	PixelFormat_RGB565, // Packed into a uint16, red in the top bits
+	PixelFormat_RGBA32F, // Plain float target, 0 to 1. Not HDR, everything drawn into it is still 8 bits per channel
+};
+
+internal int GetBytesPerPixel(game_pixel_format Format)
+{
+	int Result = 4;
+	switch (Format)
+	{
+	case PixelFormat_RGB565: Result = 2; break;
+	case PixelFormat_RGBA32F: Result = 16; break;
+	default: break;
+	}
+	return(Result);
+}
+
 // GameUpdateAndRender takes in timing, input, bitmap buffer to use, sound buffer to use, and returns bitmap and sound.
 // Non-platform depedent win32_offscreen_buffer
 struct game_offscreen_buffer
@@ -35,6 +90,7 @@ struct game_offscreen_buffer
 	int Width;
 	int Height;
 	int Pitch;
+	game_pixel_format Format;
 };
 
 struct game_sound_output_buffer
@@ -44,6 +100,97 @@ struct game_sound_output_buffer
 	int16 *Samples;
 };
 
-internal void GameUpdateAndRender(game_offscreen_buffer *Buffer, 
+// NOTE(max): Debug overlay. The platform layer fills in frame timing and sound cursors,
+// the game layer times its own blocks with RDTSC and draws everything into the backbuffer
+#define DEBUG_FRAME_HISTORY_COUNT 120
+#define DEBUG_OVERLAY_BUDGET_MS 0.2f
+
+enum debug_cycle_counter_id
+{
+	DebugCycleCounter_GameUpdateAndRender,
+	DebugCycleCounter_GameOutputSound,
+	DebugCycleCounter_AudioMixVoices,
+	DebugCycleCounter_RenderWeirdGradient,
+	DebugCycleCounter_DebugDrawOverlay,
+	DebugCycleCounter_Count,
+};
+
+struct debug_cycle_counter
+{
+	uint64 CycleCount;
+	uint32 HitCount;
+};
+
+// Byte offsets into the platform's looping sound buffer
+struct debug_sound_cursors
+{
+	uint32 PlayCursor;
+	uint32 WriteCursor;
+	uint32 ByteToLock;
+	uint32 TargetCursor;
+};
+
+// Last save game, all sizes in bytes
+struct debug_save_stats
+{
+	uint32 PageCount;
+	uint32 UncompressedSize;
+	uint32 CompressedSize;
+	real32 SnapshotMS; // Main thread, this is what hits the frame
+	real32 WorkerMS; // Compress and write on the save thread
+};
+
+struct game_debug_state
+{
+	real32 TargetMSPerFrame;
+	real32 CyclesPerMS; // From last frame's RDTSC/QPC pair, so the game can turn cycles into time
+
+	int FrameIndex; // Ring of frame times, FrameIndex is the oldest (next to be overwritten)
+	real32 FrameMS[DEBUG_FRAME_HISTORY_COUNT];
+	real32 FPS;
+	real32 MCPF;
+
+	uint32 SoundBufferSize;
+	debug_sound_cursors SoundCursors;
+	debug_save_stats SaveStats;
+
+	debug_cycle_counter Counters[DebugCycleCounter_Count]; // Accumulating this frame
+	debug_cycle_counter LastCounters[DebugCycleCounter_Count]; // Finished last frame, this is what gets drawn
+};
+
+#if HANDMADE_INTERNAL
+// Paste tokens so BEGIN_TIMED_BLOCK(Foo) and END_TIMED_BLOCK(Foo) share a local
+#define BEGIN_TIMED_BLOCK(ID) uint64 StartCycleCount##ID = __rdtsc();
+#define END_TIMED_BLOCK(ID) DebugGlobalState->Counters[DebugCycleCounter_##ID].CycleCount += __rdtsc() - StartCycleCount##ID; \
+							++DebugGlobalState->Counters[DebugCycleCounter_##ID].HitCount;
+#else
+#define BEGIN_TIMED_BLOCK(ID)
+#define END_TIMED_BLOCK(ID)
+#endif
+
+#include "handmade_audio.h"
+
+// Allocated once by the platform layer and zeroed, the game carves everything it needs out of it
+struct game_memory
+{
+	bool32 IsInitialized;
+	bool32 WasRestored; // Set by the platform after it loads a save over PermanentStorage, the game clears it
+	uint64 PermanentStorageSize;
+	void *PermanentStorage;
+};
+
+// Lives at the start of PermanentStorage
+struct game_state
+{
+	real32 tSine;
+	audio_state AudioState;
+};
+
+internal void GameUpdateAndRender(game_memory *Memory, game_offscreen_buffer *Buffer, 
 									int BlueOffset, int GreenOffset,
-									game_sound_output_buffer *SoundBuffer);
\ No newline at end of file
+									game_sound_output_buffer *SoundBuffer, int ToneHz,
+									game_debug_state *DebugState);
+
+// The platform calls this right before it loads a save over PermanentStorage, so the game can let go of
+// anything the snapshot can't carry (open files). WasRestored tells it to pick them back up afterwards
+internal void GamePrepareForLoad(game_memory *Memory);
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "handmade_audio.h"
+
+// SSE2 is always there on x64
+#include <emmintrin.h>
+
+// Walks the RIFF chunks to find the format and where the samples start. Leaves the file open for streaming
+internal bool32 OpenWavStream(wav_stream *Stream, char *FileName, bool32 Looping)
+{
+	bool32 Result = false;
+
+	*Stream = {};
+	Stream->Looping = Looping;
+	for (int CharIndex = 0; (CharIndex < ((int)sizeof(Stream->FileName) - 1)) && FileName[CharIndex]; ++CharIndex)
+	{
+		Stream->FileName[CharIndex] = FileName[CharIndex];
+	}
+	Stream->File = PlatformOpenFile(Stream->FileName);
+	if (Stream->File.NoErrors)
+	{
+		wave_header Header;
+		if ((PlatformReadFromFile(&Stream->File, 0, sizeof(Header), &Header) == sizeof(Header)) &&
+			(Header.RIFFID == WAVE_ChunkID_RIFF) &&
+			(Header.WAVEID == WAVE_ChunkID_WAVE))
+		{
+			bool32 FoundFormat = false;
+			uint64 ChunkOffset = sizeof(Header);
+			wave_chunk Chunk;
+			while (PlatformReadFromFile(&Stream->File, ChunkOffset, sizeof(Chunk), &Chunk) == sizeof(Chunk))
+			{
+				uint64 PayloadOffset = ChunkOffset + sizeof(Chunk);
+				if (Chunk.ID == WAVE_ChunkID_fmt)
+				{
+					wave_fmt Format;
+					if ((Chunk.Size >= sizeof(Format)) &&
+						(PlatformReadFromFile(&Stream->File, PayloadOffset, sizeof(Format), &Format) == sizeof(Format)) &&
+						(Format.wFormatTag == WAVE_FORMAT_TAG_PCM) &&
+						(Format.wBitsPerSample == 16) &&
+						((Format.nChannels == 1) || (Format.nChannels == 2)) &&
+						(Format.nSamplesPerSec > 0))
+					{
+						// TODO(max): 8-bit, 24-bit and float sources
+						Stream->ChannelCount = Format.nChannels;
+						Stream->SamplesPerSecond = Format.nSamplesPerSec;
+						FoundFormat = true;
+					}
+				}
+				else if (Chunk.ID == WAVE_ChunkID_data)
+				{
+					if (FoundFormat)
+					{
+						Stream->DataOffset = PayloadOffset;
+						Stream->FrameCount = Chunk.Size / (Stream->ChannelCount*sizeof(int16));
+						Result = (Stream->FrameCount > 0);
+					}
+					break;
+				}
+
+				// Chunks are padded out to an even size
+				ChunkOffset = PayloadOffset + ((Chunk.Size + 1) & ~1);
+			}
+		}
+
+		if (!Result)
+		{
+			PlatformCloseFile(&Stream->File);
+		}
+	}
+
+	return(Result);
+}
+
+internal void StopVoice(audio_voice *Voice)
+{
+	if (Voice->Playing)
+	{
+		PlatformCloseFile(&Voice->Stream.File);
+		Voice->Playing = false;
+	}
+}
+
+// The snapshot about to be loaded overwrites the handles, so close them while they're still ours
+internal void CloseVoiceFiles(audio_state *AudioState)
+{
+	for (int VoiceIndex = 0; VoiceIndex < AUDIO_MAX_VOICES; ++VoiceIndex)
+	{
+		audio_voice *Voice = &AudioState->Voices[VoiceIndex];
+		if (Voice->Playing)
+		{
+			PlatformCloseFile(&Voice->Stream.File);
+		}
+	}
+}
+
+// File handles don't survive a save game, everything else does. Picks playback up from the restored position
+internal void ReopenVoices(audio_state *AudioState)
+{
+	for (int VoiceIndex = 0; VoiceIndex < AUDIO_MAX_VOICES; ++VoiceIndex)
+	{
+		audio_voice *Voice = &AudioState->Voices[VoiceIndex];
+		if (Voice->Playing)
+		{
+			// Our own handle was closed in CloseVoiceFiles before the load. What's here now is the saving
+			// game's handle, never ours to close, so it just gets replaced. Stopped voices already hold none
+			Voice->Stream.File = PlatformOpenFile(Voice->Stream.FileName);
+			if (!Voice->Stream.File.NoErrors)
+			{
+				Voice->Playing = false;
+			}
+		}
+	}
+}
+
+// Only touches the resampler step, so it's fine to call every frame
+internal void ChangePitch(audio_voice *Voice, real32 Pitch)
+{
+	if (Pitch < AUDIO_MIN_PITCH) Pitch = AUDIO_MIN_PITCH;
+	if (Pitch > AUDIO_MAX_PITCH) Pitch = AUDIO_MAX_PITCH;
+	Voice->Pitch = Pitch;
+}
+
+// Returns 0 if there's no free voice or the file isn't a WAV we can play
+internal audio_voice *PlayWav(audio_state *AudioState, char *FileName, bool32 Looping, real32 Volume)
+{
+	audio_voice *Result = 0;
+	for (int VoiceIndex = 0; VoiceIndex < AUDIO_MAX_VOICES; ++VoiceIndex)
+	{
+		audio_voice *Voice = &AudioState->Voices[VoiceIndex];
+		if (!Voice->Playing)
+		{
+			if (OpenWavStream(&Voice->Stream, FileName, Looping))
+			{
+				Voice->Playing = true;
+				Voice->Volume = Volume;
+				Voice->Pitch = 1.0f;
+				Voice->RingWriteFrame = 0;
+				Voice->Position = 0;
+				Result = Voice;
+			}
+			break;
+		}
+	}
+	return(Result);
+}
+
+// Decode whole chunks into the ring until it's full or the file runs out. Returns whether anything new arrived
+internal bool32 StreamVoice(audio_state *AudioState, audio_voice *Voice)
+{
+	bool32 Result = false;
+	wav_stream *Stream = &Voice->Stream;
+	uint32 BytesPerFrame = Stream->ChannelCount*sizeof(int16);
+
+	for (;;)
+	{
+		uint64 FramesBuffered = Voice->RingWriteFrame - (Voice->Position >> 32);
+		if ((AUDIO_VOICE_RING_FRAME_COUNT - FramesBuffered) < AUDIO_DECODE_CHUNK_FRAME_COUNT)
+		{
+			break;
+		}
+
+		if (Stream->NextDecodeFrame == Stream->FrameCount)
+		{
+			if (!Stream->Looping)
+			{
+				break;
+			}
+			// Looping just keeps writing into the ring, so the seam is sample accurate
+			Stream->NextDecodeFrame = 0;
+		}
+
+		uint32 FrameCount = Stream->FrameCount - Stream->NextDecodeFrame;
+		if (FrameCount > AUDIO_DECODE_CHUNK_FRAME_COUNT)
+		{
+			FrameCount = AUDIO_DECODE_CHUNK_FRAME_COUNT;
+		}
+
+		// TODO(max): Overlapped reads a chunk ahead, so the mixer never waits on the disk
+		uint64 ReadOffset = Stream->DataOffset + (uint64)Stream->NextDecodeFrame*BytesPerFrame;
+		uint32 BytesRead = PlatformReadFromFile(&Stream->File, ReadOffset, FrameCount*BytesPerFrame, AudioState->DecodeScratch);
+		FrameCount = BytesRead / BytesPerFrame;
+		if (FrameCount == 0)
+		{
+			// Truncated file or the read failed. Treat it as the end so we don't spin on it
+			Stream->FrameCount = Stream->NextDecodeFrame;
+			Stream->Looping = false;
+			break;
+		}
+
+		int16 *Source = AudioState->DecodeScratch;
+		for (uint32 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+		{
+			uint32 RingIndex = (uint32)(Voice->RingWriteFrame + FrameIndex) & (AUDIO_VOICE_RING_FRAME_COUNT - 1);
+			real32 Left = (real32)*Source++;
+			real32 Right = (Stream->ChannelCount == 2) ? (real32)*Source++ : Left;
+			Voice->RingL[RingIndex] = Left;
+			Voice->RingR[RingIndex] = Right;
+		}
+
+		Stream->NextDecodeFrame += FrameCount;
+		Voice->RingWriteFrame += FrameCount;
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// Linear resample from the voice ring, accumulating into the mix block. Stops early when the ring runs dry
+// (needs one frame past the read position to interpolate). Returns how many output frames were mixed
+internal int ResampleVoice(audio_voice *Voice, uint64 Step, real32 *MixL, real32 *MixR, int FrameCount)
+{
+	uint32 RingMask = AUDIO_VOICE_RING_FRAME_COUNT - 1;
+	real32 FractionScale = 1.0f / 4294967296.0f;
+	__m128 Volume = _mm_set1_ps(Voice->Volume);
+
+	int FrameIndex = 0;
+	for (; (FrameIndex + 4) <= FrameCount; FrameIndex += 4)
+	{
+		if ((((Voice->Position + 3*Step) >> 32) + 1) >= Voice->RingWriteFrame)
+		{
+			break;
+		}
+
+		// No gather in SSE2, so fetch the taps one lane at a time and do the math four wide
+		real32 L0[4], L1[4], R0[4], R1[4], Fraction[4];
+		for (int Lane = 0; Lane < 4; ++Lane)
+		{
+			uint64 LanePosition = Voice->Position + Lane*Step;
+			uint32 Index0 = (uint32)(LanePosition >> 32) & RingMask;
+			uint32 Index1 = (Index0 + 1) & RingMask;
+			L0[Lane] = Voice->RingL[Index0];
+			L1[Lane] = Voice->RingL[Index1];
+			R0[Lane] = Voice->RingR[Index0];
+			R1[Lane] = Voice->RingR[Index1];
+			Fraction[Lane] = (real32)(uint32)LanePosition*FractionScale;
+		}
+
+		__m128 t = _mm_loadu_ps(Fraction);
+		__m128 A = _mm_loadu_ps(L0);
+		__m128 Left = _mm_add_ps(A, _mm_mul_ps(t, _mm_sub_ps(_mm_loadu_ps(L1), A)));
+		A = _mm_loadu_ps(R0);
+		__m128 Right = _mm_add_ps(A, _mm_mul_ps(t, _mm_sub_ps(_mm_loadu_ps(R1), A)));
+
+		_mm_storeu_ps(MixL + FrameIndex, _mm_add_ps(_mm_loadu_ps(MixL + FrameIndex), _mm_mul_ps(Left, Volume)));
+		_mm_storeu_ps(MixR + FrameIndex, _mm_add_ps(_mm_loadu_ps(MixR + FrameIndex), _mm_mul_ps(Right, Volume)));
+
+		Voice->Position += 4*Step;
+	}
+
+	// Leftover frames when the block isn't a multiple of four
+	for (; FrameIndex < FrameCount; ++FrameIndex)
+	{
+		if (((Voice->Position >> 32) + 1) >= Voice->RingWriteFrame)
+		{
+			break;
+		}
+
+		uint32 Index0 = (uint32)(Voice->Position >> 32) & RingMask;
+		uint32 Index1 = (Index0 + 1) & RingMask;
+		real32 t = (real32)(uint32)Voice->Position*FractionScale;
+		MixL[FrameIndex] += Voice->Volume*(Voice->RingL[Index0] + t*(Voice->RingL[Index1] - Voice->RingL[Index0]));
+		MixR[FrameIndex] += Voice->Volume*(Voice->RingR[Index0] + t*(Voice->RingR[Index1] - Voice->RingR[Index0]));
+
+		Voice->Position += Step;
+	}
+
+	return(FrameIndex);
+}
+
+// Mix every playing voice into the output in small blocks, so the mix buffer can live on the stack
+internal void AudioMixVoices(audio_state *AudioState, game_sound_output_buffer *SoundBuffer)
+{
+	BEGIN_TIMED_BLOCK(AudioMixVoices);
+
+	int16 *SampleOut = SoundBuffer->Samples;
+	int FramesRemaining = SoundBuffer->SampleCount;
+	while (FramesRemaining > 0)
+	{
+		int BlockFrameCount = FramesRemaining;
+		if (BlockFrameCount > AUDIO_MIX_BLOCK_FRAME_COUNT)
+		{
+			BlockFrameCount = AUDIO_MIX_BLOCK_FRAME_COUNT;
+		}
+
+		real32 MixL[AUDIO_MIX_BLOCK_FRAME_COUNT] = {};
+		real32 MixR[AUDIO_MIX_BLOCK_FRAME_COUNT] = {};
+
+		for (int VoiceIndex = 0; VoiceIndex < AUDIO_MAX_VOICES; ++VoiceIndex)
+		{
+			audio_voice *Voice = &AudioState->Voices[VoiceIndex];
+			if (Voice->Playing)
+			{
+				// Source rate conversion and pitch are the same thing to the resampler
+				real64 Ratio = ((real64)Voice->Stream.SamplesPerSecond / (real64)SoundBuffer->SamplesPerSecond)*(real64)Voice->Pitch;
+				uint64 Step = (uint64)(Ratio*4294967296.0);
+
+				int FramesMixed = 0;
+				while (FramesMixed < BlockFrameCount)
+				{
+					FramesMixed += ResampleVoice(Voice, Step, MixL + FramesMixed, MixR + FramesMixed, BlockFrameCount - FramesMixed);
+					if ((FramesMixed < BlockFrameCount) && !StreamVoice(AudioState, Voice))
+					{
+						// Ring is dry and the file has nothing left
+						StopVoice(Voice);
+						break;
+					}
+				}
+			}
+		}
+
+		// Interleave back to LRLR and saturate to 16 bits
+		int FrameIndex = 0;
+		for (; (FrameIndex + 4) <= BlockFrameCount; FrameIndex += 4)
+		{
+			__m128i Left = _mm_cvtps_epi32(_mm_loadu_ps(MixL + FrameIndex));
+			__m128i Right = _mm_cvtps_epi32(_mm_loadu_ps(MixR + FrameIndex));
+			__m128i LR01 = _mm_unpacklo_epi32(Left, Right);
+			__m128i LR23 = _mm_unpackhi_epi32(Left, Right);
+			_mm_storeu_si128((__m128i *)SampleOut, _mm_packs_epi32(LR01, LR23));
+			SampleOut += 8;
+		}
+		for (; FrameIndex < BlockFrameCount; ++FrameIndex)
+		{
+			real32 Mix[2] = {MixL[FrameIndex], MixR[FrameIndex]};
+			for (int Channel = 0; Channel < 2; ++Channel)
+			{
+				real32 Value = Mix[Channel];
+				if (Value > 32767.0f) Value = 32767.0f;
+				if (Value < -32768.0f) Value = -32768.0f;
+				// Round to nearest like _mm_cvtps_epi32 above, so the output doesn't depend on the block size
+				*SampleOut++ = (int16)_mm_cvtss_si32(_mm_set_ss(Value));
+			}
+		}
+
+		FramesRemaining -= BlockFrameCount;
+	}
+
+	END_TIMED_BLOCK(AudioMixVoices);
+}
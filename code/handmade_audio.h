@@ -0,0 +1,86 @@
+#pragma once
+
+// NOTE(max): Streaming WAV playback. Each voice keeps its file open and decodes a chunk at a time
+// into a small ring of real32 frames, which gets resampled straight into the mix. Nothing about
+// a voice is ever allocated after startup, so long tracks are never fully resident.
+
+#define RIFF_CODE(a, b, c, d) (((uint32)(a) << 0) | ((uint32)(b) << 8) | ((uint32)(c) << 16) | ((uint32)(d) << 24))
+
+enum
+{
+	WAVE_ChunkID_fmt = RIFF_CODE('f', 'm', 't', ' '),
+	WAVE_ChunkID_data = RIFF_CODE('d', 'a', 't', 'a'),
+	WAVE_ChunkID_RIFF = RIFF_CODE('R', 'I', 'F', 'F'),
+	WAVE_ChunkID_WAVE = RIFF_CODE('W', 'A', 'V', 'E'),
+};
+
+#define WAVE_FORMAT_TAG_PCM 1
+
+// On-disk layouts, so no padding
+#pragma pack(push, 1)
+struct wave_header
+{
+	uint32 RIFFID;
+	uint32 Size;
+	uint32 WAVEID;
+};
+
+struct wave_chunk
+{
+	uint32 ID;
+	uint32 Size;
+};
+
+struct wave_fmt
+{
+	uint16 wFormatTag;
+	uint16 nChannels;
+	uint32 nSamplesPerSec;
+	uint32 nAvgBytesPerSec;
+	uint16 nBlockAlign;
+	uint16 wBitsPerSample;
+};
+#pragma pack(pop)
+
+// Sizes are in frames (one sample per channel). The ring has to be a power of two so indices can wrap with a mask
+#define AUDIO_MAX_VOICES 4
+#define AUDIO_VOICE_RING_FRAME_COUNT 4096
+#define AUDIO_DECODE_CHUNK_FRAME_COUNT 1024
+#define AUDIO_MIX_BLOCK_FRAME_COUNT 256
+
+#define AUDIO_MIN_PITCH 0.25f
+#define AUDIO_MAX_PITCH 4.0f
+
+struct wav_stream
+{
+	char FileName[128]; // Kept so the file can be reopened after a save game is loaded
+	platform_file_handle File;
+	uint32 ChannelCount; // 16-bit PCM, mono or stereo only
+	uint32 SamplesPerSecond;
+	uint64 DataOffset; // Byte offset of the first frame in the file
+	uint32 FrameCount;
+	uint32 NextDecodeFrame;
+	bool32 Looping;
+};
+
+struct audio_voice
+{
+	bool32 Playing;
+	wav_stream Stream;
+	real32 Volume;
+	real32 Pitch;
+
+	// Deinterleaved so the resampler can work on four frames at once
+	real32 RingL[AUDIO_VOICE_RING_FRAME_COUNT];
+	real32 RingR[AUDIO_VOICE_RING_FRAME_COUNT];
+	uint64 RingWriteFrame; // Total frames decoded so far, only ever goes up
+
+	// 32.32 fixed point, in the same frame numbering as RingWriteFrame. Fixed point so long tracks don't drift
+	uint64 Position;
+};
+
+struct audio_state
+{
+	audio_voice Voices[AUDIO_MAX_VOICES];
+	int16 DecodeScratch[AUDIO_DECODE_CHUNK_FRAME_COUNT*2]; // Raw file bytes land here before conversion
+};
@@ -0,0 +1,200 @@
+// NOTE(max): Small LZ77 codec in the spirit of LZ4, used for save games. Greedy matching off a single
+// hash table, byte aligned output, no entropy coding. It's fast rather than small.
+//
+// Each sequence is:
+//   token (high nibble literal count, low nibble match length - LZ_MIN_MATCH, 15 means more follows)
+//   extra literal count bytes (each 255 means keep going)
+//   literals
+//   match offset (16-bit little endian)
+//   extra match length bytes
+// The last sequence is literals only and stops at the end of the input.
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+#define LZ_HASH_BITS 14
+#define LZ_HASH_COUNT (1 << LZ_HASH_BITS)
+
+// Worst case output size, for sizing the destination up front
+internal uint32 LZCompressBound(uint32 SourceSize)
+{
+	return(SourceSize + (SourceSize / 255) + 16);
+}
+
+internal uint32 LZRead32(uint8 *At)
+{
+	uint32 Result = (At[0] << 0) | (At[1] << 8) | (At[2] << 16) | ((uint32)At[3] << 24);
+	return(Result);
+}
+
+internal uint8 *LZWriteCount(uint8 *Out, uint32 Count)
+{
+	while (Count >= 255)
+	{
+		*Out++ = 255;
+		Count -= 255;
+	}
+	*Out++ = (uint8)Count;
+	return(Out);
+}
+
+internal uint8 *LZWriteSequence(uint8 *Out, uint8 *Literals, uint32 LiteralCount, uint32 MatchLength, uint32 MatchOffset)
+{
+	uint32 MatchCode = MatchLength ? (MatchLength - LZ_MIN_MATCH) : 0;
+
+	uint8 *Token = Out++;
+	*Token = (uint8)((((LiteralCount < 15) ? LiteralCount : 15) << 4) | ((MatchCode < 15) ? MatchCode : 15));
+	if (LiteralCount >= 15)
+	{
+		Out = LZWriteCount(Out, LiteralCount - 15);
+	}
+
+	for (uint32 Index = 0; Index < LiteralCount; ++Index)
+	{
+		*Out++ = Literals[Index];
+	}
+
+	if (MatchLength)
+	{
+		*Out++ = (uint8)(MatchOffset & 0xFF);
+		*Out++ = (uint8)(MatchOffset >> 8);
+		if (MatchCode >= 15)
+		{
+			Out = LZWriteCount(Out, MatchCode - 15);
+		}
+	}
+
+	return(Out);
+}
+
+// Dest needs LZCompressBound(SourceSize) bytes, HashTable needs LZ_HASH_COUNT entries. Returns the compressed size
+internal uint32 LZCompress(uint8 *Source, uint32 SourceSize, uint8 *Dest, uint32 *HashTable)
+{
+	for (uint32 HashIndex = 0; HashIndex < LZ_HASH_COUNT; ++HashIndex)
+	{
+		HashTable[HashIndex] = 0;
+	}
+
+	uint8 *Out = Dest;
+	uint32 Anchor = 0;
+	uint32 At = 0;
+	while ((At + LZ_MIN_MATCH) <= SourceSize)
+	{
+		uint32 Sequence = LZRead32(Source + At);
+		uint32 Hash = (Sequence*2654435761u) >> (32 - LZ_HASH_BITS); // Knuth's multiplicative hash
+		uint32 Candidate = HashTable[Hash];
+		HashTable[Hash] = At;
+
+		// Stale or colliding entries just fail the compare, so the table never needs to be exact
+		if ((Candidate < At) &&
+			((At - Candidate) <= LZ_MAX_OFFSET) &&
+			(LZRead32(Source + Candidate) == Sequence))
+		{
+			uint32 MatchLength = LZ_MIN_MATCH;
+			while (((At + MatchLength) < SourceSize) &&
+				(Source[Candidate + MatchLength] == Source[At + MatchLength]))
+			{
+				++MatchLength;
+			}
+
+			Out = LZWriteSequence(Out, Source + Anchor, At - Anchor, MatchLength, At - Candidate);
+			At += MatchLength;
+			Anchor = At;
+		}
+		else
+		{
+			++At;
+		}
+	}
+
+	Out = LZWriteSequence(Out, Source + Anchor, SourceSize - Anchor, 0, 0);
+
+	return((uint32)(Out - Dest));
+}
+
+internal bool32 LZReadCount(uint8 **At, uint8 *End, uint32 *Count)
+{
+	bool32 Result = true;
+	uint8 Byte;
+	do
+	{
+		if (*At >= End)
+		{
+			Result = false;
+			break;
+		}
+		Byte = *(*At)++;
+		*Count += Byte;
+	} while (Byte == 255);
+	return(Result);
+}
+
+// Bounds checked, since the input comes off disk. Returns the decompressed size, or 0 if the data is bad
+internal uint32 LZDecompress(uint8 *Source, uint32 SourceSize, uint8 *Dest, uint32 DestSize)
+{
+	uint8 *In = Source;
+	uint8 *InEnd = Source + SourceSize;
+	uint8 *Out = Dest;
+	uint8 *OutEnd = Dest + DestSize;
+
+	bool32 Valid = (SourceSize > 0);
+	while (Valid && (In < InEnd))
+	{
+		uint8 Token = *In++;
+
+		uint32 LiteralCount = Token >> 4;
+		if ((LiteralCount == 15) && !LZReadCount(&In, InEnd, &LiteralCount))
+		{
+			Valid = false;
+			break;
+		}
+		if ((LiteralCount > (uint32)(InEnd - In)) || (LiteralCount > (uint32)(OutEnd - Out)))
+		{
+			Valid = false;
+			break;
+		}
+		for (uint32 Index = 0; Index < LiteralCount; ++Index)
+		{
+			*Out++ = *In++;
+		}
+
+		if (In == InEnd)
+		{
+			// Literals-only sequence at the end
+			break;
+		}
+
+		if ((InEnd - In) < 2)
+		{
+			Valid = false;
+			break;
+		}
+		uint32 MatchOffset = In[0] | (In[1] << 8);
+		In += 2;
+
+		uint32 MatchLength = Token & 15;
+		if ((MatchLength == 15) && !LZReadCount(&In, InEnd, &MatchLength))
+		{
+			Valid = false;
+			break;
+		}
+		MatchLength += LZ_MIN_MATCH;
+
+		if ((MatchOffset == 0) ||
+			(MatchOffset > (uint32)(Out - Dest)) ||
+			(MatchLength > (uint32)(OutEnd - Out)))
+		{
+			Valid = false;
+			break;
+		}
+
+		// Byte at a time on purpose, matches are allowed to overlap what they're writing
+		uint8 *Match = Out - MatchOffset;
+		for (uint32 Index = 0; Index < MatchLength; ++Index)
+		{
+			*Out++ = *Match++;
+		}
+	}
+
+	uint32 Result = Valid ? (uint32)(Out - Dest) : 0;
+	return(Result);
+}
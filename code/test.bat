@@ -0,0 +1,17 @@
+@echo off
+
+:: Run shell if cl is not a recognized command
+cl >NUL 2>&1 || ( call ../misc/shell.bat )
+
+:: Headless tests build and run in the build directory, and leave their WAVs there to listen to
+IF NOT EXIST ..\build mkdir ..\build 2> NUL
+pushd ..\build
+
+cl -FC -Zi ..\code\test_audio.cpp
+test_audio.exe
+
+:: Benchmarks need the optimizer on to mean anything
+cl -FC -Zi -O2 ..\code\bench_save.cpp
+bench_save.exe
+
+popd
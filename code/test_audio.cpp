@@ -0,0 +1,204 @@
+// Headless audio test. No window and no sound card: writes sine WAVs at the source rates we ship content
+// at, streams them through GameOutputSound at the 48kHz output rate, writes what came out to a WAV next to
+// an ideal reference, and checks they match within what linear resampling should cost. Pitch and looping
+// go through the same check: a pitched voice is just a sine at ToneHz*Pitch, and a source holding a whole
+// number of periods loops without a seam.
+//
+// Build and run with test.bat (or `g++ test_audio.cpp` anywhere else). Exits non-zero on failure.
+#include "handmade.h"
+#include "handmade.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// stdio stand-ins for the platform file services, all the game layer needs to stream
+internal platform_file_handle PlatformOpenFile(char *FileName)
+{
+	platform_file_handle Result = {};
+	FILE *File = fopen(FileName, "rb");
+	if (File)
+	{
+		fseek(File, 0, SEEK_END);
+		Result.Size = ftell(File);
+		Result.NoErrors = true;
+		Result.Platform = File;
+	}
+	return(Result);
+}
+
+internal uint32 PlatformReadFromFile(platform_file_handle *Handle, uint64 Offset, uint32 Size, void *Dest)
+{
+	uint32 Result = 0;
+	if (Handle->NoErrors && (fseek((FILE *)Handle->Platform, (long)Offset, SEEK_SET) == 0))
+	{
+		Result = (uint32)fread(Dest, 1, Size, (FILE *)Handle->Platform);
+	}
+	return(Result);
+}
+
+internal void PlatformCloseFile(platform_file_handle *Handle)
+{
+	if (Handle->Platform)
+	{
+		fclose((FILE *)Handle->Platform);
+	}
+	*Handle = {};
+}
+
+#define TEST_OUTPUT_SAMPLES_PER_SECOND 48000
+#define TEST_AMPLITUDE 10000.0f
+// Linear interpolation costs about 0.5% RMS on a 1kHz tone from 22.05kHz, leave some room
+#define TEST_MAX_RMS_ERROR (0.015f*TEST_AMPLITUDE)
+
+internal bool32 WriteWav(char *FileName, uint32 SamplesPerSecond, uint32 ChannelCount, uint32 FrameCount, int16 *Samples)
+{
+	bool32 Result = false;
+	FILE *File = fopen(FileName, "wb");
+	if (File)
+	{
+		uint32 DataSize = FrameCount*ChannelCount*sizeof(int16);
+
+		wave_header Header = {WAVE_ChunkID_RIFF, (uint32)(4 + 2*sizeof(wave_chunk) + sizeof(wave_fmt) + DataSize), WAVE_ChunkID_WAVE};
+		wave_chunk FormatChunk = {WAVE_ChunkID_fmt, sizeof(wave_fmt)};
+		wave_fmt Format = {};
+		Format.wFormatTag = WAVE_FORMAT_TAG_PCM;
+		Format.nChannels = (uint16)ChannelCount;
+		Format.nSamplesPerSec = SamplesPerSecond;
+		Format.nBlockAlign = (uint16)(ChannelCount*sizeof(int16));
+		Format.nAvgBytesPerSec = SamplesPerSecond*Format.nBlockAlign;
+		Format.wBitsPerSample = 16;
+		wave_chunk DataChunk = {WAVE_ChunkID_data, DataSize};
+
+		Result = ((fwrite(&Header, sizeof(Header), 1, File) == 1) &&
+			(fwrite(&FormatChunk, sizeof(FormatChunk), 1, File) == 1) &&
+			(fwrite(&Format, sizeof(Format), 1, File) == 1) &&
+			(fwrite(&DataChunk, sizeof(DataChunk), 1, File) == 1) &&
+			(fwrite(Samples, DataSize, 1, File) == 1));
+		fclose(File);
+	}
+	return(Result);
+}
+
+// Interleaved, one tone per channel
+internal void GenerateSine(int16 *Samples, uint32 SamplesPerSecond, uint32 ChannelCount, uint32 FrameCount, real32 *ToneHz)
+{
+	for (uint32 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+	{
+		for (uint32 Channel = 0; Channel < ChannelCount; ++Channel)
+		{
+			real64 t = (real64)FrameIndex / (real64)SamplesPerSecond;
+			*Samples++ = (int16)(TEST_AMPLITUDE*sin(2.0*Pi32*ToneHz[Channel]*t));
+		}
+	}
+}
+
+internal bool32 RunResampleTest(char *Name, uint32 SourceSamplesPerSecond, uint32 SourceChannelCount, real32 LeftHz, real32 RightHz,
+									real32 Seconds, real32 Pitch, bool32 Looping)
+{
+	bool32 Passed = true;
+	real32 ToneHz[2] = {LeftHz, RightHz};
+
+	char SourceName[64];
+	char OutputName[64];
+	char ReferenceName[64];
+	sprintf(SourceName, "test_audio_%s_source.wav", Name);
+	sprintf(OutputName, "test_audio_%s_output.wav", Name);
+	sprintf(ReferenceName, "test_audio_%s_reference.wav", Name);
+
+	uint32 SourceFrameCount = (uint32)(Seconds*SourceSamplesPerSecond);
+	int16 *Source = (int16 *)calloc(SourceFrameCount*SourceChannelCount, sizeof(int16));
+	GenerateSine(Source, SourceSamplesPerSecond, SourceChannelCount, SourceFrameCount, ToneHz);
+	WriteWav(SourceName, SourceSamplesPerSecond, SourceChannelCount, SourceFrameCount, Source);
+
+	// Mono sources come out the same on both sides, and pitch scales every tone
+	if (SourceChannelCount == 1)
+	{
+		ToneHz[1] = ToneHz[0];
+	}
+	ToneHz[0] *= Pitch;
+	ToneHz[1] *= Pitch;
+
+	// One short pull past the end of the source, so the voice has to run dry and stop.
+	// A looping source never ends, so it gets a second of output, which is several times round
+	uint32 ExpectedFrameCount = (uint32)((Seconds*TEST_OUTPUT_SAMPLES_PER_SECOND) / Pitch);
+	uint32 OutputFrameCount = ExpectedFrameCount + 64;
+	if (Looping)
+	{
+		ExpectedFrameCount = TEST_OUTPUT_SAMPLES_PER_SECOND;
+		OutputFrameCount = ExpectedFrameCount;
+	}
+	int16 *Output = (int16 *)calloc(OutputFrameCount*2, sizeof(int16));
+	int16 *Reference = (int16 *)calloc(OutputFrameCount*2, sizeof(int16));
+	GenerateSine(Reference, TEST_OUTPUT_SAMPLES_PER_SECOND, 2, ExpectedFrameCount, ToneHz);
+
+	game_state *GameState = (game_state *)calloc(1, sizeof(game_state));
+	audio_voice *Voice = PlayWav(&GameState->AudioState, SourceName, Looping, 1.0f);
+	if (Voice)
+	{
+		ChangePitch(Voice, Pitch);
+
+		// About what the platform layer asks for at 30fps, uneven on purpose so blocks don't line up
+		uint32 FramesPerUpdate = 1601;
+		for (uint32 FrameIndex = 0; FrameIndex < OutputFrameCount; FrameIndex += FramesPerUpdate)
+		{
+			game_sound_output_buffer SoundBuffer = {};
+			SoundBuffer.SamplesPerSecond = TEST_OUTPUT_SAMPLES_PER_SECOND;
+			SoundBuffer.SampleCount = (int)(((OutputFrameCount - FrameIndex) < FramesPerUpdate) ? (OutputFrameCount - FrameIndex) : FramesPerUpdate);
+			SoundBuffer.Samples = Output + FrameIndex*2;
+			GameOutputSound(GameState, &SoundBuffer, 256);
+		}
+	}
+	else
+	{
+		printf("%s: couldn't play %s\n", Name, SourceName);
+		Passed = false;
+	}
+
+	WriteWav(OutputName, TEST_OUTPUT_SAMPLES_PER_SECOND, 2, OutputFrameCount, Output);
+	WriteWav(ReferenceName, TEST_OUTPUT_SAMPLES_PER_SECOND, 2, OutputFrameCount, Reference);
+
+	// The last source frame has nothing to interpolate towards, so leave a few frames out of the comparison
+	uint32 CompareFrameCount = ExpectedFrameCount - 8;
+	for (uint32 Channel = 0; Channel < 2; ++Channel)
+	{
+		real64 ErrorSquared = 0.0;
+		for (uint32 FrameIndex = 0; FrameIndex < CompareFrameCount; ++FrameIndex)
+		{
+			real64 Error = (real64)Output[FrameIndex*2 + Channel] - (real64)Reference[FrameIndex*2 + Channel];
+			ErrorSquared += Error*Error;
+		}
+		real32 RMSError = (real32)sqrt(ErrorSquared / (real64)CompareFrameCount);
+		printf("%s: channel %u rms error %.2f (max %.2f)\n", Name, Channel, RMSError, TEST_MAX_RMS_ERROR);
+		if (RMSError > TEST_MAX_RMS_ERROR)
+		{
+			Passed = false;
+		}
+	}
+
+	// The voice has to stop where the source ends, not loop or keep playing garbage. (Once it has,
+	// GameOutputSound goes back to the test tone, so the tail isn't silent). A looping one never stops
+	if (GameState->AudioState.Voices[0].Playing != Looping)
+	{
+		printf("%s: voice %s\n", Name, Looping ? "stopped while looping" : "still playing after the end of the source");
+		Passed = false;
+	}
+
+	printf("%s: %s\n", Name, Passed ? "passed" : "FAILED");
+
+	free(GameState);
+	free(Reference);
+	free(Output);
+	free(Source);
+
+	return(Passed);
+}
+
+int main(int ArgCount, char **Args)
+{
+	bool32 Passed = true;
+	Passed &= RunResampleTest("22050_mono", 22050, 1, 1000.0f, 1000.0f, 1.0f, 1.0f, false);
+	Passed &= RunResampleTest("44100_stereo", 44100, 2, 440.0f, 1500.0f, 1.0f, 1.0f, false);
+	// 250 and 125 whole periods in a quarter second, looped 16 times at four times the pitch
+	Passed &= RunResampleTest("24000_loop_pitch4", 24000, 2, 1000.0f, 500.0f, 0.25f, 4.0f, true);
+	return(Passed ? 0 : 1);
+}
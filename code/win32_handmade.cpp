@@ -13,6 +13,7 @@
 // #include "handmade.cpp" is the "Unity" build (no, not the game engine)
 // Instead of chaining on the cli (cl ... win32_handmade.cpp handmade.cpp), everything in one translation unit
 #include "handmade.cpp"
+#include "handmade_lz.cpp"
 
 // Put as much above windows.h as possible, so #defines do not conflict
 #include <windows.h>
@@ -28,11 +29,13 @@ struct win32_offscreen_buffer
 	int Width;
 	int Height;
 	int Pitch;
+	game_pixel_format Format;
 };
 
 global_variable bool32 GlobalRunning;
 global_variable win32_offscreen_buffer GlobalBackbuffer;
 global_variable LPDIRECTSOUNDBUFFER GlobalSecondaryBuffer;
+global_variable int64 GlobalPerfCountFrequency;
 
 struct win32_window_dimension
 {
@@ -70,10 +73,516 @@ global_variable x_input_set_state *XInputSetState_ = XInputSetStateStub;
 #define DIRECT_SOUND_CREATE(name) HRESULT WINAPI name(LPCGUID pcGuidDevice, LPDIRECTSOUND *ppDS, LPUNKNOWN pUnkOuter)
 typedef DIRECT_SOUND_CREATE(direct_sound_create);
 
-// Implements Win32 file loading
-void* PlatformLoadFile(char *FileName)
+internal platform_read_file_result PlatformReadEntireFile(char *FileName)
 {
-	return 0;
+	platform_read_file_result Result = {};
+
+	HANDLE FileHandle = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER FileSize;
+		if (GetFileSizeEx(FileHandle, &FileSize) && (FileSize.QuadPart <= 0xFFFFFFFF))
+		{
+			uint32 FileSize32 = (uint32)FileSize.QuadPart;
+			Result.Contents = VirtualAlloc(0, FileSize32, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (Result.Contents)
+			{
+				DWORD BytesRead;
+				if (ReadFile(FileHandle, Result.Contents, FileSize32, &BytesRead, 0) && (BytesRead == FileSize32))
+				{
+					Result.ContentsSize = FileSize32;
+				}
+				else
+				{
+					// TODO(max): Logging
+					PlatformFreeFileMemory(Result.Contents);
+					Result.Contents = 0;
+				}
+			}
+		}
+		CloseHandle(FileHandle);
+	}
+
+	return(Result);
+}
+
+internal void PlatformFreeFileMemory(void *Memory)
+{
+	if (Memory)
+	{
+		VirtualFree(Memory, 0, MEM_RELEASE);
+	}
+}
+
+internal bool32 PlatformWriteEntireFile(char *FileName, uint32 MemorySize, void *Memory)
+{
+	bool32 Result = false;
+
+	// Write next to the real file and swap it in, so a crash mid-write never leaves a torn file behind
+	char TempFileName[MAX_PATH];
+	sprintf_s(TempFileName, "%s.tmp", FileName);
+	HANDLE FileHandle = CreateFileA(TempFileName, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		DWORD BytesWritten;
+		bool32 Written = (WriteFile(FileHandle, Memory, MemorySize, &BytesWritten, 0) && (BytesWritten == MemorySize));
+		// Make sure the bytes are on disk before the rename makes them the real file
+		Written = Written && FlushFileBuffers(FileHandle);
+		CloseHandle(FileHandle);
+
+		if (Written)
+		{
+			Result = MoveFileExA(TempFileName, FileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+		}
+		if (!Result)
+		{
+			// TODO(max): Logging
+			DeleteFileA(TempFileName);
+		}
+	}
+
+	return(Result);
+}
+
+internal platform_file_handle PlatformOpenFile(char *FileName)
+{
+	platform_file_handle Result = {};
+
+	HANDLE FileHandle = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER FileSize;
+		if (GetFileSizeEx(FileHandle, &FileSize))
+		{
+			Result.NoErrors = true;
+			Result.Size = FileSize.QuadPart;
+			Result.Platform = FileHandle;
+		}
+		else
+		{
+			// TODO(max): Logging
+			CloseHandle(FileHandle);
+		}
+	}
+	else
+	{
+		// TODO(max): Logging
+	}
+
+	return(Result);
+}
+
+internal uint32 PlatformReadFromFile(platform_file_handle *Handle, uint64 Offset, uint32 Size, void *Dest)
+{
+	DWORD BytesRead = 0;
+	if (Handle->NoErrors)
+	{
+		// On a synchronous handle the OVERLAPPED offset just says where to read from
+		OVERLAPPED Overlapped = {};
+		Overlapped.Offset = (DWORD)(Offset & 0xFFFFFFFF);
+		Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+		if (!ReadFile((HANDLE)Handle->Platform, Dest, Size, &BytesRead, &Overlapped))
+		{
+			// TODO(max): Logging
+			BytesRead = 0;
+		}
+	}
+	return(BytesRead);
+}
+
+internal void PlatformCloseFile(platform_file_handle *Handle)
+{
+	if (Handle->Platform)
+	{
+		CloseHandle((HANDLE)Handle->Platform);
+	}
+	*Handle = {};
+}
+
+internal LARGE_INTEGER Win32GetWallClock()
+{
+	LARGE_INTEGER Result;
+	QueryPerformanceCounter(&Result);
+	return(Result);
+}
+
+internal real32 Win32GetMSElapsed(LARGE_INTEGER Start, LARGE_INTEGER End)
+{
+	real32 Result = (1000.0f*(real32)(End.QuadPart - Start.QuadPart)) / (real32)GlobalPerfCountFrequency;
+	return(Result);
+}
+
+// NOTE(max): Save games. PermanentStorage is allocated with MEM_WRITE_WATCH, so Windows tells us which
+// pages were written since the last save. A save is a chain of files: a full save (sequence 0) with every
+// page ever written, then deltas holding only the pages dirtied since the save before. The main thread only
+// copies the dirty pages out at a frame boundary. Compressing and writing happens on the save thread.
+//
+// File layout: win32_save_header, then the LZ compressed payload, which is uint32 page indices followed
+// by the page contents in the same order.
+#define WIN32_SAVE_MAGIC_VALUE RIFF_CODE('h', 'm', 's', 'v')
+#define WIN32_SAVE_VERSION 1
+#define WIN32_SAVE_MAX_DELTAS 16 // After this many deltas the next save is a full one, so loads stay short
+
+struct win32_save_header
+{
+	uint32 MagicValue;
+	uint32 Version;
+	uint32 Generation; // Bumped by every full save. Deltas only apply on top of the full save they came from
+	uint32 Sequence;
+	uint64 MemorySize;
+	uint32 PageSize;
+	uint32 PageCount;
+	uint32 UncompressedSize;
+	uint32 CompressedSize;
+};
+
+struct win32_save_state
+{
+	bool32 Enabled;
+	bool32 SaveRequested;
+	bool32 LoadRequested;
+
+	uint32 PageSize;
+	uint32 PageCount;
+	uint32 BitmapWordCount;
+	uint32 *DirtyBitmap; // Pages written since the last save
+	uint32 *EverDirtyBitmap; // Pages written since startup (or restored by a load), what a full save needs
+	void **WriteWatchAddresses;
+
+	uint32 Generation;
+	uint32 NextSequence; // 0 means the next save is a full one
+
+	// Busy is set by the main thread when it hands over a job, and cleared by the save thread once the file
+	// is on disk. The main thread doesn't touch anything below while it's set
+	volatile LONG Busy;
+	HANDLE JobSemaphore;
+	win32_save_header JobHeader;
+	uint8 *Staging;
+	uint8 *Compressed; // Header goes first, so the file is written in one go
+	uint32 *HashTable;
+	bool32 ChainBroken; // A write failed, so the next save has to be a full one
+
+	debug_save_stats Stats; // Snapshot half filled in before the handoff, the save thread fills in the rest
+};
+
+global_variable win32_save_state GlobalSaveState;
+
+internal void Win32GetSaveFileName(uint32 Sequence, char *Dest, int DestSize)
+{
+	// TODO(max): Real saved game location (user's app data, not next to the assets)
+	sprintf_s(Dest, DestSize, "../data/save_%04u.hms", Sequence);
+}
+
+internal bool32 Win32PageIsSet(uint32 *Bitmap, uint32 PageIndex)
+{
+	bool32 Result = ((Bitmap[PageIndex / 32] & (1 << (PageIndex % 32))) != 0);
+	return(Result);
+}
+
+internal void Win32SetPage(uint32 *Bitmap, uint32 PageIndex)
+{
+	Bitmap[PageIndex / 32] |= (1 << (PageIndex % 32));
+}
+
+DWORD WINAPI Win32SaveThreadProc(LPVOID lpParameter)
+{
+	win32_save_state *SaveState = (win32_save_state *)lpParameter;
+	for (;;)
+	{
+		WaitForSingleObjectEx(SaveState->JobSemaphore, INFINITE, FALSE);
+
+		LARGE_INTEGER Start = Win32GetWallClock();
+
+		win32_save_header *Header = (win32_save_header *)SaveState->Compressed;
+		*Header = SaveState->JobHeader;
+		Header->CompressedSize = LZCompress(SaveState->Staging, Header->UncompressedSize,
+			SaveState->Compressed + sizeof(win32_save_header), SaveState->HashTable);
+
+		char FileName[MAX_PATH];
+		Win32GetSaveFileName(Header->Sequence, FileName, sizeof(FileName));
+		if (!PlatformWriteEntireFile(FileName, sizeof(win32_save_header) + Header->CompressedSize, SaveState->Compressed))
+		{
+			// TODO(max): Logging
+			SaveState->ChainBroken = true;
+		}
+
+		SaveState->Stats.PageCount = Header->PageCount;
+		SaveState->Stats.UncompressedSize = Header->UncompressedSize;
+		SaveState->Stats.CompressedSize = Header->CompressedSize;
+		SaveState->Stats.WorkerMS = Win32GetMSElapsed(Start, Win32GetWallClock());
+
+		// Full barrier, so everything above is visible before the main thread sees we're free
+		InterlockedExchange(&SaveState->Busy, 0);
+	}
+}
+
+internal void Win32InitSaveState(win32_save_state *SaveState, game_memory *Memory)
+{
+	SYSTEM_INFO SystemInfo;
+	GetSystemInfo(&SystemInfo);
+	SaveState->PageSize = SystemInfo.dwPageSize;
+	SaveState->PageCount = (uint32)(Memory->PermanentStorageSize / SaveState->PageSize);
+	SaveState->BitmapWordCount = (SaveState->PageCount + 31) / 32;
+
+	// Worst case is every page: an index and the contents of each
+	uint32 StagingSize = SaveState->PageCount*(sizeof(uint32) + SaveState->PageSize);
+	uint32 CompressedSize = sizeof(win32_save_header) + LZCompressBound(StagingSize);
+	uint32 BitmapSize = SaveState->BitmapWordCount*sizeof(uint32);
+	uint32 AddressesSize = SaveState->PageCount*sizeof(void *);
+	uint32 HashTableSize = LZ_HASH_COUNT*sizeof(uint32);
+
+	// Untouched pages never get physical memory, so the worst case sizing is only address space
+	uint8 *Block = (uint8 *)VirtualAlloc(0, StagingSize + CompressedSize + 2*BitmapSize + AddressesSize + HashTableSize,
+										MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	SaveState->JobSemaphore = CreateSemaphoreEx(0, 0, 1, 0, 0, SEMAPHORE_ALL_ACCESS);
+	if (Block && SaveState->JobSemaphore)
+	{
+		SaveState->Staging = Block;
+		SaveState->Compressed = SaveState->Staging + StagingSize;
+		SaveState->DirtyBitmap = (uint32 *)(SaveState->Compressed + CompressedSize);
+		SaveState->EverDirtyBitmap = SaveState->DirtyBitmap + SaveState->BitmapWordCount;
+		SaveState->WriteWatchAddresses = (void **)(SaveState->EverDirtyBitmap + SaveState->BitmapWordCount);
+		SaveState->HashTable = (uint32 *)(SaveState->WriteWatchAddresses + SaveState->PageCount);
+
+		// Carry on from whatever chain is already on disk, so its old deltas can't be mistaken for ours.
+		// Only the header, the full save can be as big as PermanentStorage
+		char FileName[MAX_PATH];
+		Win32GetSaveFileName(0, FileName, sizeof(FileName));
+		platform_file_handle File = PlatformOpenFile(FileName);
+		win32_save_header Header = {};
+		if (PlatformReadFromFile(&File, 0, sizeof(Header), &Header) == sizeof(Header))
+		{
+			SaveState->Generation = Header.Generation;
+		}
+		PlatformCloseFile(&File);
+
+		HANDLE ThreadHandle = CreateThread(0, 0, Win32SaveThreadProc, SaveState, 0, 0);
+		if (ThreadHandle)
+		{
+			CloseHandle(ThreadHandle);
+			SaveState->Enabled = true;
+		}
+	}
+	else
+	{
+		// TODO(max): Logging
+	}
+}
+
+// Turns the write watch into DirtyBitmap (and folds it into EverDirtyBitmap), then resets it
+internal bool32 Win32GatherDirtyPages(win32_save_state *SaveState, game_memory *Memory)
+{
+	bool32 Result = false;
+
+	ULONG_PTR AddressCount = SaveState->PageCount;
+	ULONG Granularity;
+	if (GetWriteWatch(WRITE_WATCH_FLAG_RESET, Memory->PermanentStorage, (SIZE_T)Memory->PermanentStorageSize,
+		SaveState->WriteWatchAddresses, &AddressCount, &Granularity) == 0)
+	{
+		for (uint32 WordIndex = 0; WordIndex < SaveState->BitmapWordCount; ++WordIndex)
+		{
+			SaveState->DirtyBitmap[WordIndex] = 0;
+		}
+		for (ULONG_PTR AddressIndex = 0; AddressIndex < AddressCount; ++AddressIndex)
+		{
+			uint32 PageIndex = (uint32)(((uint8 *)SaveState->WriteWatchAddresses[AddressIndex] - (uint8 *)Memory->PermanentStorage) / SaveState->PageSize);
+			Win32SetPage(SaveState->DirtyBitmap, PageIndex);
+			Win32SetPage(SaveState->EverDirtyBitmap, PageIndex);
+		}
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// Called between frames, so the copy is a consistent snapshot. Only the copy costs the frame anything
+internal void Win32BeginSave(win32_save_state *SaveState, game_memory *Memory)
+{
+	LARGE_INTEGER Start = Win32GetWallClock();
+
+	if (Win32GatherDirtyPages(SaveState, Memory))
+	{
+		if (SaveState->ChainBroken)
+		{
+			SaveState->NextSequence = 0;
+			SaveState->ChainBroken = false;
+		}
+
+		win32_save_header *Header = &SaveState->JobHeader;
+		*Header = {};
+		Header->MagicValue = WIN32_SAVE_MAGIC_VALUE;
+		Header->Version = WIN32_SAVE_VERSION;
+		Header->MemorySize = Memory->PermanentStorageSize;
+		Header->PageSize = SaveState->PageSize;
+		if (SaveState->NextSequence == 0)
+		{
+			++SaveState->Generation;
+		}
+		Header->Generation = SaveState->Generation;
+		Header->Sequence = SaveState->NextSequence;
+
+		uint32 *Bitmap = (Header->Sequence == 0) ? SaveState->EverDirtyBitmap : SaveState->DirtyBitmap;
+		for (uint32 PageIndex = 0; PageIndex < SaveState->PageCount; ++PageIndex)
+		{
+			if (Win32PageIsSet(Bitmap, PageIndex))
+			{
+				++Header->PageCount;
+			}
+		}
+
+		uint32 *PageIndices = (uint32 *)SaveState->Staging;
+		uint8 *PageContents = SaveState->Staging + Header->PageCount*sizeof(uint32);
+		for (uint32 PageIndex = 0; PageIndex < SaveState->PageCount; ++PageIndex)
+		{
+			if (Win32PageIsSet(Bitmap, PageIndex))
+			{
+				*PageIndices++ = PageIndex;
+				CopyMemory(PageContents, (uint8 *)Memory->PermanentStorage + PageIndex*SaveState->PageSize, SaveState->PageSize);
+				PageContents += SaveState->PageSize;
+			}
+		}
+		Header->UncompressedSize = (uint32)(PageContents - SaveState->Staging);
+
+		SaveState->NextSequence = (Header->Sequence < WIN32_SAVE_MAX_DELTAS) ? (Header->Sequence + 1) : 0;
+
+		SaveState->Stats = {};
+		SaveState->Stats.SnapshotMS = Win32GetMSElapsed(Start, Win32GetWallClock());
+
+		InterlockedExchange(&SaveState->Busy, 1);
+		ReleaseSemaphore(SaveState->JobSemaphore, 1, 0);
+	}
+}
+
+// Reads one file of the chain and unpacks it into Staging. Returns the page count, or -1 if it's missing,
+// corrupt or belongs to a different chain
+internal int Win32ReadSaveFile(win32_save_state *SaveState, game_memory *Memory, uint32 Sequence, uint32 *Generation)
+{
+	int Result = -1;
+
+	char FileName[MAX_PATH];
+	Win32GetSaveFileName(Sequence, FileName, sizeof(FileName));
+	platform_read_file_result File = PlatformReadEntireFile(FileName);
+	if (File.ContentsSize >= sizeof(win32_save_header))
+	{
+		win32_save_header *Header = (win32_save_header *)File.Contents;
+		uint32 MaxUncompressedSize = SaveState->PageCount*(sizeof(uint32) + SaveState->PageSize);
+		if ((Header->MagicValue == WIN32_SAVE_MAGIC_VALUE) &&
+			(Header->Version == WIN32_SAVE_VERSION) &&
+			(Header->Sequence == Sequence) &&
+			((Sequence == 0) || (Header->Generation == *Generation)) &&
+			(Header->MemorySize == Memory->PermanentStorageSize) &&
+			(Header->PageSize == SaveState->PageSize) &&
+			(Header->PageCount <= SaveState->PageCount) &&
+			(Header->UncompressedSize == Header->PageCount*(sizeof(uint32) + SaveState->PageSize)) &&
+			(Header->UncompressedSize <= MaxUncompressedSize) &&
+			(Header->CompressedSize == (File.ContentsSize - sizeof(win32_save_header))))
+		{
+			uint32 Size = LZDecompress((uint8 *)File.Contents + sizeof(win32_save_header), Header->CompressedSize,
+				SaveState->Staging, Header->UncompressedSize);
+			if (Size == Header->UncompressedSize)
+			{
+				Result = Header->PageCount;
+				uint32 *PageIndices = (uint32 *)SaveState->Staging;
+				for (uint32 Index = 0; Index < Header->PageCount; ++Index)
+				{
+					if (PageIndices[Index] >= SaveState->PageCount)
+					{
+						Result = -1;
+						break;
+					}
+				}
+				if (Result >= 0)
+				{
+					*Generation = Header->Generation;
+				}
+			}
+		}
+	}
+	PlatformFreeFileMemory(File.Contents);
+
+	return(Result);
+}
+
+internal void Win32ApplySavePages(win32_save_state *SaveState, game_memory *Memory, int PageCount)
+{
+	uint32 *PageIndices = (uint32 *)SaveState->Staging;
+	uint8 *PageContents = SaveState->Staging + PageCount*sizeof(uint32);
+	for (int Index = 0; Index < PageCount; ++Index)
+	{
+		CopyMemory((uint8 *)Memory->PermanentStorage + PageIndices[Index]*SaveState->PageSize, PageContents, SaveState->PageSize);
+		PageContents += SaveState->PageSize;
+		Win32SetPage(SaveState->EverDirtyBitmap, PageIndices[Index]);
+	}
+}
+
+// Full save, then every delta after it, stopping at the first one that's missing or from another chain.
+// Happens on the main thread, a load is allowed to hitch
+internal bool32 Win32LoadSave(win32_save_state *SaveState, game_memory *Memory)
+{
+	bool32 Result = false;
+
+	uint32 Generation = 0;
+	int PageCount = Win32ReadSaveFile(SaveState, Memory, 0, &Generation);
+	if (PageCount >= 0)
+	{
+		// Last chance for the game to close what it has open before memory gets overwritten
+		GamePrepareForLoad(Memory);
+
+		// Pages written since the last save need putting back too
+		Win32GatherDirtyPages(SaveState, Memory);
+
+		// Pages the full save doesn't have were zero when it was taken
+		for (uint32 PageIndex = 0; PageIndex < SaveState->PageCount; ++PageIndex)
+		{
+			if (Win32PageIsSet(SaveState->EverDirtyBitmap, PageIndex))
+			{
+				ZeroMemory((uint8 *)Memory->PermanentStorage + PageIndex*SaveState->PageSize, SaveState->PageSize);
+			}
+		}
+		for (uint32 WordIndex = 0; WordIndex < SaveState->BitmapWordCount; ++WordIndex)
+		{
+			SaveState->EverDirtyBitmap[WordIndex] = 0;
+		}
+		Win32ApplySavePages(SaveState, Memory, PageCount);
+
+		uint32 Sequence = 1;
+		for (; Sequence <= WIN32_SAVE_MAX_DELTAS; ++Sequence)
+		{
+			PageCount = Win32ReadSaveFile(SaveState, Memory, Sequence, &Generation);
+			if (PageCount < 0)
+			{
+				break;
+			}
+			Win32ApplySavePages(SaveState, Memory, PageCount);
+		}
+
+		// If the chain ended early on a bad delta, later ones can still be sitting there from this generation,
+		// and writing the next delta over the gap would splice them back in. A full save starts a new generation
+		uint32 NextSequence = (Sequence <= WIN32_SAVE_MAX_DELTAS) ? Sequence : 0;
+		for (uint32 LaterSequence = Sequence + 1; NextSequence && (LaterSequence <= WIN32_SAVE_MAX_DELTAS); ++LaterSequence)
+		{
+			char FileName[MAX_PATH];
+			Win32GetSaveFileName(LaterSequence, FileName, sizeof(FileName));
+			platform_file_handle File = PlatformOpenFile(FileName);
+			if (File.NoErrors)
+			{
+				NextSequence = 0;
+			}
+			PlatformCloseFile(&File);
+		}
+
+		// Memory now matches the chain on disk, so the next delta starts from here
+		ResetWriteWatch(Memory->PermanentStorage, (SIZE_T)Memory->PermanentStorageSize);
+		SaveState->Generation = Generation;
+		SaveState->NextSequence = NextSequence;
+		SaveState->ChainBroken = false;
+		Memory->WasRestored = true;
+		// A snapshot only ever comes from an initialized game, even if this one hasn't run a frame yet
+		Memory->IsInitialized = true;
+		Result = true;
+	}
+
+	return(Result);
 }
 
 // Take loading Windows DLL into our own hands
@@ -208,7 +717,8 @@ internal void Win32ResizeDIBSection(win32_offscreen_buffer *Buffer, int Width, i
 	// Fill out bitmap info header
 	Buffer->Width = Width;
 	Buffer->Height = Height;
-	int BytesPerPixel = 4;
+	Buffer->Format = PixelFormat_BGRA8; // What a 32-bit BI_RGB DIB section is, so the game renders straight into it
+	int BytesPerPixel = GetBytesPerPixel(Buffer->Format);
 
 	Buffer->Info.bmiHeader.biSize = sizeof(Buffer->Info.bmiHeader);
 	Buffer->Info.bmiHeader.biWidth = Buffer->Width;
@@ -331,6 +841,15 @@ LRESULT CALLBACK Win32MainWindowCallback(HWND Window, UINT Message, WPARAM WPara
 			{
 				OutputDebugStringA("VK_SPACE\n");
 			}
+			else if (VKCode == VK_F5)
+			{
+				// Picked up at the end of the frame, so the snapshot is consistent
+				if (IsDown) GlobalSaveState.SaveRequested = true;
+			}
+			else if (VKCode == VK_F9)
+			{
+				if (IsDown) GlobalSaveState.LoadRequested = true;
+			}
 		}
 
 		bool32 AltKeyWasDown = ((LParam & (1 << 29)) != 0);
@@ -439,12 +958,30 @@ internal void Win32FillSoundBuffer(win32_sound_output *SoundOutput, DWORD ByteTo
 	}
 }
 
+// Close out the frame for the debug overlay: push the frame time into the ring and
+// hand this frame's cycle counters over to be drawn next frame
+internal void Win32DebugEndFrame(game_debug_state *DebugState, real32 MSPerFrame, real32 FPS, real32 MCPF, real32 CyclesPerMS)
+{
+	DebugState->FrameMS[DebugState->FrameIndex] = MSPerFrame;
+	DebugState->FrameIndex = (DebugState->FrameIndex + 1) % DEBUG_FRAME_HISTORY_COUNT;
+	DebugState->FPS = FPS;
+	DebugState->MCPF = MCPF;
+	DebugState->CyclesPerMS = CyclesPerMS;
+
+	for (int CounterIndex = 0; CounterIndex < DebugCycleCounter_Count; ++CounterIndex)
+	{
+		DebugState->LastCounters[CounterIndex] = DebugState->Counters[CounterIndex];
+		DebugState->Counters[CounterIndex].CycleCount = 0;
+		DebugState->Counters[CounterIndex].HitCount = 0;
+	}
+}
+
 // Entry point for Windows
 int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLine, int ShowCode)
 {
 	LARGE_INTEGER PerfCountFrequencyResult;
 	QueryPerformanceFrequency(&PerfCountFrequencyResult); // Fixed at system boot time, we only need to ask once
-	int64 PerfCountFrequency = PerfCountFrequencyResult.QuadPart;
+	GlobalPerfCountFrequency = PerfCountFrequencyResult.QuadPart;
 
 	// Load XInput from DLL manually
 	Win32LoadXInput();
@@ -493,12 +1030,33 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 
 			GlobalRunning = true;
 
+			// TODO(max): Actually lock the frame rate, for now this is just the line on the overlay graph
+			int GameUpdateHz = 30;
+			game_debug_state DebugState = {};
+			DebugState.TargetMSPerFrame = 1000.0f / (real32)GameUpdateHz;
+			DebugState.SoundBufferSize = SoundOutput.SecondaryBufferSize;
 			
 			// TODO(max): Pool with bitmap VirtualAlloc
 			// Allocate a backing store where we can copy sounds out to the ring buffer
 			int16 *Samples = (int16 *)VirtualAlloc(0, SoundOutput.SecondaryBufferSize, 
 													MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 
+			// VirtualAlloc hands back zeroed pages, so the game can tell a fresh start from IsInitialized.
+			// MEM_WRITE_WATCH is how saves find out which pages changed
+			game_memory GameMemory = {};
+			GameMemory.PermanentStorageSize = Megabytes(64);
+			GameMemory.PermanentStorage = VirtualAlloc(0, GameMemory.PermanentStorageSize,
+													MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE);
+			if (!Samples || !GameMemory.PermanentStorage)
+			{
+				// TODO(max): Logging
+				GlobalRunning = false;
+			}
+			else
+			{
+				Win32InitSaveState(&GlobalSaveState, &GameMemory);
+			}
+
 			LARGE_INTEGER LastCounter; // Uses a union (multiple structs overlay some same space in memory) .QuadPart to access as 64bit, .LowPart+.HighPart to access as 32-bit
 			QueryPerformanceCounter(&LastCounter);
 			uint64 LastCycleCount = __rdtsc(); // Snap the RDTSC counter from the processor. An "intrinsic" for RDTSC
@@ -554,7 +1112,7 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 				// [LEFT RIGHT] LEFT  RIGHT ...
 				DWORD ByteToLock;
 				DWORD TargetCursor;
-				DWORD BytesToWrite; // Output number of samples we actually want for this frame
+				DWORD BytesToWrite = 0; // Output number of samples we actually want for this frame
 				DWORD PlayCursor;
 				DWORD WriteCursor;
 				bool32 SoundIsValid = false;
@@ -577,6 +1135,18 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 					}
 					
 					SoundIsValid = true;
+
+					DebugState.SoundCursors.PlayCursor = PlayCursor;
+					DebugState.SoundCursors.WriteCursor = WriteCursor;
+					DebugState.SoundCursors.ByteToLock = ByteToLock;
+					DebugState.SoundCursors.TargetCursor = TargetCursor;
+				}
+
+				// Loads land before the game runs, so it sees the restored state this frame
+				if (GlobalSaveState.LoadRequested && GlobalSaveState.Enabled && !GlobalSaveState.Busy)
+				{
+					Win32LoadSave(&GlobalSaveState, &GameMemory);
+					GlobalSaveState.LoadRequested = false;
 				}
 
 				game_sound_output_buffer SoundBuffer = {};
@@ -590,7 +1160,8 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 				Buffer.Width = GlobalBackbuffer.Width;
 				Buffer.Height = GlobalBackbuffer.Height;
 				Buffer.Pitch = GlobalBackbuffer.Pitch;
-				GameUpdateAndRender(&Buffer, XOffset, YOffset, &SoundBuffer, SoundOutput.ToneHz);
+				Buffer.Format = GlobalBackbuffer.Format;
+				GameUpdateAndRender(&GameMemory, &Buffer, XOffset, YOffset, &SoundBuffer, SoundOutput.ToneHz, &DebugState);
 
 				// DirectSound picks a point in the 2s buffer to write to
 				// Region 1 is the actual location of the write cursor offset, to where it should end in the next 2s buffer
@@ -603,6 +1174,18 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 					Win32FillSoundBuffer(&SoundOutput, ByteToLock, BytesToWrite, &SoundBuffer);
 				}
 
+				// If the last save is still being written this just waits for a later frame
+				if (GlobalSaveState.SaveRequested && GlobalSaveState.Enabled && !GlobalSaveState.Busy)
+				{
+					Win32BeginSave(&GlobalSaveState, &GameMemory);
+					GlobalSaveState.SaveRequested = false;
+				}
+				// The save thread owns the stats until it hands back
+				if (!GlobalSaveState.Busy)
+				{
+					DebugState.SaveStats = GlobalSaveState.Stats;
+				}
+
 				// Blit to screen
 				win32_window_dimension Dimension = Win32GetWindowDimension(Window);
 				Win32DisplayBufferInWindow(&GlobalBackbuffer, DeviceContext, Dimension.Width, Dimension.Height, 0, 0, Dimension.Width, Dimension.Height);
@@ -620,8 +1203,8 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 				int64 CounterElapsed = EndCounter.QuadPart - LastCounter.QuadPart; // Compute difference
 				
 				// real64s are free here, because sprintf_s upconverts real32s
-				real64 MSPerFrame = (((1000.0f*(real64)CounterElapsed) / (real64)PerfCountFrequency)); // How many wall clock seconds actually elapsed
-				real64 FPS = (real64)PerfCountFrequency / (real64)CounterElapsed;
+				real64 MSPerFrame = (((1000.0f*(real64)CounterElapsed) / (real64)GlobalPerfCountFrequency)); // How many wall clock seconds actually elapsed
+				real64 FPS = (real64)GlobalPerfCountFrequency / (real64)CounterElapsed;
 				real64 MCPF = (real64)(CyclesElapsed / (1000.0f * 1000.0f)); // Printing out a 64-bit integer is relatively new
 
 #if 0
@@ -629,6 +1212,9 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, LPSTR CommandLi
 				sprintf_s(Buffer, "%.02fms/f, %.02f FPS, %.02fM instructions/frame\n", MSPerFrame, FPS, MCPF);
 				OutputDebugStringA(Buffer);
 #endif
+				real32 CyclesPerMS = (real32)((real64)CyclesElapsed / MSPerFrame);
+				Win32DebugEndFrame(&DebugState, (real32)MSPerFrame, (real32)FPS, (real32)MCPF, CyclesPerMS);
+
 				LastCounter = EndCounter; // With QueryPerformanceCounter
 				LastCycleCount = EndCycleCount; // With RDTSC
 			}